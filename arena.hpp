@@ -0,0 +1,65 @@
+#ifndef PARSIM_ARENA_H
+#define PARSIM_ARENA_H
+
+#include <cstdint>
+#include <vector>
+
+// Contiguous storage that's filled, cleared and filled again, once per build
+// of whatever lives in it. Clearing keeps the capacity, so once the arena
+// has grown to the largest build seen, building again doesn't allocate.
+// Elements are addressed by a 32-bit index, which unlike a reference stays
+// valid while the arena grows.
+template <typename T>
+class Arena {
+public:
+    using Index = uint32_t;
+
+    Index add(T const& value) {
+        items.push_back(value);
+        return items.size() - 1;
+    }
+    void clear() {
+        items.clear();
+    }
+    void resize(size_t n) {
+        items.resize(n);
+    }
+    void swap(Arena& other) {
+        items.swap(other.items);
+    }
+    size_t size() const {
+        return items.size();
+    }
+    bool empty() const {
+        return items.empty();
+    }
+    T& operator[](Index i) {
+        return items[i];
+    }
+    T const& operator[](Index i) const {
+        return items[i];
+    }
+    T *data() {
+        return items.data();
+    }
+    T const *data() const {
+        return items.data();
+    }
+    T *begin() {
+        return items.data();
+    }
+    T *end() {
+        return items.data() + items.size();
+    }
+    T const *begin() const {
+        return items.data();
+    }
+    T const *end() const {
+        return items.data() + items.size();
+    }
+
+private:
+    std::vector<T> items;
+};
+
+#endif /* PARSIM_ARENA_H */
\ No newline at end of file
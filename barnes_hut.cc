@@ -0,0 +1,460 @@
+#include <algorithm>
+
+#include "barnes_hut.hpp"
+#include "kernels.hpp"
+#include "profile.hpp"
+#include "simulation.hpp"
+
+BarnesHutSolver::BarnesHutSolver(size_t _groupSize) : groupSize(_groupSize) {}
+
+void BarnesHutSolver::computeField(
+    Simulation const& simulation,
+    std::vector<RealVec2>& field,
+    ThreadPool& pool
+) {
+    cellInteractions = 0;
+    bodyInteractions = 0;
+    nodeVisits = 0;
+    perBody.resize(simulation.size());
+    if (groupSize > 0) {
+        computeGroupField(simulation, nullptr, field, pool);
+    } else {
+        computeBodyField(simulation, nullptr, field, pool);
+    }
+}
+
+void BarnesHutSolver::computeFieldFor(
+    Simulation const& simulation,
+    std::vector<Entity> const& active,
+    std::vector<RealVec2>& field,
+    ThreadPool& pool
+) {
+    cellInteractions = 0;
+    bodyInteractions = 0;
+    nodeVisits = 0;
+    perBody.resize(simulation.size());
+    if (groupSize == 0) {
+        computeBodyField(simulation, &active, field, pool);
+        return;
+    }
+    activeFlags.assign(simulation.size(), false);
+    for (Entity e : active) {
+        activeFlags[e] = true;
+    }
+    computeGroupField(simulation, &activeFlags, field, pool);
+}
+
+void BarnesHutSolver::computeBodyField(
+    Simulation const& simulation,
+    std::vector<Entity> const *active,
+    std::vector<RealVec2>& field,
+    ThreadPool& pool
+) {
+    pool.parallelFor(
+        active ? active->size() : simulation.size(),
+        simulation.forceChunkSize,
+        [&](size_t begin, size_t end) {
+            Interactions counts = {0, 0, 0};
+            for (size_t j = begin; j < end; j++) {
+                Entity const e = active ? (*active)[j] : Entity(j);
+                size_t const before = counts.cells + counts.bodies;
+                field[e] = fieldAt(simulation, e, counts);
+                perBody[e] = counts.cells + counts.bodies - before;
+            }
+            cellInteractions += counts.cells;
+            bodyInteractions += counts.bodies;
+            PARSIM_COUNT(nodeVisits += counts.visits);
+        }
+    );
+}
+
+BarnesHutSolver::Interactions BarnesHutSolver::interactions() const {
+    return {cellInteractions, bodyInteractions, nodeVisits};
+}
+
+std::vector<uint32_t> const *BarnesHutSolver::interactionsPerBody() const {
+    return &perBody;
+}
+
+RealVec2 BarnesHutSolver::fieldAt(
+    Simulation const& simulation,
+    Entity e,
+    Interactions& counts
+) {
+    QuadTree const& tree = simulation.tree;
+    RealVec2 const position = simulation.bodies.position(e);
+    Real const
+        theta = simulation.theta
+    ,   gamma = simulation.gamma
+    ;
+    bool const quadrupoles = simulation.quadrupoles;
+
+    // Opening a node means going to its first child, which is the node right
+    // after it. Accepting it, or summing up the bodies of a leaf, means
+    // jumping past its subtree.
+    QuadTree::Hot const *nodes = tree.hot.data();
+    QuadTree::Index const end = tree.nodeCount();
+    RealVec2 farPull = {0, 0};
+    RealVec2 nearPull = {0, 0};
+    for (QuadTree::Index i = 0; i < end;) {
+        QuadTree::Hot const& node = nodes[i];
+        PARSIM_COUNT(counts.visits++);
+        Real const
+            regionWidth = node.size
+        ,   distX = node.massCenter.x - position.x
+        ,   distY = node.massCenter.y - position.y
+        ,   dist = std::sqrt(distX * distX + distY * distY)
+        ;
+        bool const
+            isLeaf = node.next == i + 1
+        ,   isFar = regionWidth / dist < theta
+        ;
+        if (isLeaf && !isFar) {
+            // the body's own leaf gets here too, `directSum` skips it
+            nearPull += directSum(
+                position,
+                tree.bodyX.data() + node.first,
+                tree.bodyY.data() + node.first,
+                tree.bodyMasses.data() + node.first,
+                node.count
+            );
+            counts.bodies += node.count;
+            i = node.next;
+            continue;
+        }
+        if (!isFar) {
+            i++;
+            continue;
+        }
+        Real const
+            distCos = distX / dist
+        ,   distSin = distY / dist
+        ,   pullModulo = node.mass / dist / dist
+        ;
+        farPull.y += pullModulo * distSin;
+        farPull.x += pullModulo * distCos;
+        if (quadrupoles) {
+            std::array<Real, 3> const& q = tree.quadrupoles[i];
+            farPull += quadrupolePull(distX, distY, q[0], q[1], q[2]);
+        }
+        counts.cells++;
+        i = node.next;
+    }
+    return (farPull + nearPull) * gamma;
+}
+
+void BarnesHutSolver::InteractionList::clear() {
+    cellX.clear();
+    cellY.clear();
+    cellMasses.clear();
+    cellQxx.clear();
+    cellQxy.clear();
+    cellQyy.clear();
+    leaves.clear();
+    visits = 0;
+}
+
+void BarnesHutSolver::computeGroupField(
+    Simulation const& simulation,
+    std::vector<char> const *activeFlags,
+    std::vector<RealVec2>& field,
+    ThreadPool& pool
+) {
+    QuadTree const& tree = simulation.tree;
+    collectGroups(tree);
+
+    bool const quadrupoles = simulation.quadrupoles;
+    pool.parallelFor(
+        groups.size(),
+        std::max<size_t>(simulation.forceChunkSize / groupSize, 1),
+        [&](size_t begin, size_t end) {
+            Interactions counts = {0, 0, 0};
+            InteractionList list;
+            for (size_t g = begin; g < end; g++) {
+                QuadTree::Hot const& group = tree.hot[groups[g]];
+                auto const
+                    first = tree.bodies.begin() + group.first
+                ,   last = first + group.count
+                ;
+                bool const isActive = !activeFlags || std::any_of(
+                    first,
+                    last,
+                    [&](Entity e) { return (*activeFlags)[e]; }
+                );
+                if (!isActive) {
+                    continue;
+                }
+                buildInteractionList(simulation, group, list);
+                PARSIM_COUNT(counts.visits += list.visits);
+                size_t const cells = list.cellX.size();
+                size_t leafBodies = 0;
+                for (auto const& leaf : list.leaves) {
+                    leafBodies += leaf.second;
+                }
+                size_t evaluated = 0;
+                for (
+                    auto k = group.first;
+                    k < group.first + group.count;
+                    k++
+                ) {
+                    if (activeFlags && !(*activeFlags)[tree.bodies[k]]) {
+                        continue;
+                    }
+                    evaluated++;
+                    RealVec2 const position = {
+                        tree.bodyX[k],
+                        tree.bodyY[k],
+                    };
+                    RealVec2 pull = directSum(
+                        position,
+                        list.cellX.data(),
+                        list.cellY.data(),
+                        list.cellMasses.data(),
+                        cells
+                    );
+                    if (quadrupoles) {
+                        pull += quadrupoleSum(
+                            position,
+                            list.cellX.data(),
+                            list.cellY.data(),
+                            list.cellQxx.data(),
+                            list.cellQxy.data(),
+                            list.cellQyy.data(),
+                            cells
+                        );
+                    }
+                    for (auto const& [first, count] : list.leaves) {
+                        pull += directSum(
+                            position,
+                            tree.bodyX.data() + first,
+                            tree.bodyY.data() + first,
+                            tree.bodyMasses.data() + first,
+                            count
+                        );
+                        counts.bodies += count;
+                    }
+                    field[tree.bodies[k]] = pull * simulation.gamma;
+                    perBody[tree.bodies[k]] = cells + leafBodies;
+                }
+                counts.cells += cells * evaluated;
+            }
+            cellInteractions += counts.cells;
+            bodyInteractions += counts.bodies;
+            PARSIM_COUNT(nodeVisits += counts.visits);
+        }
+    );
+}
+
+void BarnesHutSolver::computeSplitField(
+    Simulation const& simulation,
+    std::vector<RealVec2>& far,
+    std::vector<RealVec2>& near,
+    ThreadPool& pool
+) {
+    cellInteractions = 0;
+    bodyInteractions = 0;
+    nodeVisits = 0;
+    QuadTree const& tree = simulation.tree;
+    collectGroups(tree);
+    nearLists.resize(groups.size());
+
+    bool const quadrupoles = simulation.quadrupoles;
+    size_t const bodiesPerGroup = std::max(groupSize, tree.leafCapacity);
+    pool.parallelFor(
+        groups.size(),
+        std::max<size_t>(simulation.forceChunkSize / bodiesPerGroup, 1),
+        [&](size_t begin, size_t end) {
+            size_t cellCount = 0;
+            [[maybe_unused]] size_t visits = 0;
+            InteractionList list;
+            for (size_t g = begin; g < end; g++) {
+                QuadTree::Hot const& group = tree.hot[groups[g]];
+                buildInteractionList(simulation, group, list);
+                PARSIM_COUNT(visits += list.visits);
+                size_t const cells = list.cellX.size();
+                NearList& nearList = nearLists[g];
+                nearList.targets.assign(
+                    tree.bodies.begin() + group.first,
+                    tree.bodies.begin() + group.first + group.count
+                );
+                nearList.sources.clear();
+                nearList.sourceMasses.clear();
+                for (auto const& [first, count] : list.leaves) {
+                    nearList.sources.insert(
+                        nearList.sources.end(),
+                        tree.bodies.begin() + first,
+                        tree.bodies.begin() + first + count
+                    );
+                    nearList.sourceMasses.insert(
+                        nearList.sourceMasses.end(),
+                        tree.bodyMasses.begin() + first,
+                        tree.bodyMasses.begin() + first + count
+                    );
+                }
+                for (
+                    auto k = group.first;
+                    k < group.first + group.count;
+                    k++
+                ) {
+                    RealVec2 const position = {
+                        tree.bodyX[k],
+                        tree.bodyY[k],
+                    };
+                    RealVec2 pull = directSum(
+                        position,
+                        list.cellX.data(),
+                        list.cellY.data(),
+                        list.cellMasses.data(),
+                        cells
+                    );
+                    if (quadrupoles) {
+                        pull += quadrupoleSum(
+                            position,
+                            list.cellX.data(),
+                            list.cellY.data(),
+                            list.cellQxx.data(),
+                            list.cellQxy.data(),
+                            list.cellQyy.data(),
+                            cells
+                        );
+                    }
+                    far[tree.bodies[k]] = pull * simulation.gamma;
+                }
+                cellCount += cells * group.count;
+            }
+            cellInteractions += cellCount;
+            PARSIM_COUNT(nodeVisits += visits);
+        }
+    );
+    sumNearField(simulation, near, pool);
+}
+
+void BarnesHutSolver::computeNearField(
+    Simulation const& simulation,
+    std::vector<RealVec2>& near,
+    ThreadPool& pool
+) {
+    cellInteractions = 0;
+    bodyInteractions = 0;
+    nodeVisits = 0;
+    sumNearField(simulation, near, pool);
+}
+
+void BarnesHutSolver::sumNearField(
+    Simulation const& simulation,
+    std::vector<RealVec2>& near,
+    ThreadPool& pool
+) {
+    size_t const bodiesPerGroup =
+        std::max(groupSize, simulation.tree.leafCapacity);
+    pool.parallelFor(
+        nearLists.size(),
+        std::max<size_t>(simulation.forceChunkSize / bodiesPerGroup, 1),
+        [&](size_t begin, size_t end) {
+            size_t bodyCount = 0;
+            std::vector<Real> sourceX, sourceY;
+            for (size_t g = begin; g < end; g++) {
+                NearList const& nearList = nearLists[g];
+                size_t const sources = nearList.sources.size();
+                sourceX.resize(sources);
+                sourceY.resize(sources);
+                for (size_t j = 0; j < sources; j++) {
+                    Entity const source = nearList.sources[j];
+                    sourceX[j] = simulation.bodies.x[source];
+                    sourceY[j] = simulation.bodies.y[source];
+                }
+                for (Entity e : nearList.targets) {
+                    near[e] = directSum(
+                        simulation.bodies.position(e),
+                        sourceX.data(),
+                        sourceY.data(),
+                        nearList.sourceMasses.data(),
+                        sources
+                    ) * simulation.gamma;
+                }
+                bodyCount += sources * nearList.targets.size();
+            }
+            bodyInteractions += bodyCount;
+        }
+    );
+}
+
+bool BarnesHutSolver::nearFieldNeedsTree() const {
+    return false;
+}
+
+void BarnesHutSolver::collectGroups(QuadTree const& tree) {
+    QuadTree::Index const end = tree.nodeCount();
+    groups.clear();
+    for (QuadTree::Index i = 0; i < end;) {
+        QuadTree::Hot const& node = tree.hot[i];
+        if ((size_t)node.count <= groupSize || tree.isLeaf(i)) {
+            if (node.count > 0) {
+                groups.push_back(i);
+            }
+            i = node.next;
+        } else {
+            i++;
+        }
+    }
+}
+
+void BarnesHutSolver::buildInteractionList(
+    Simulation const& simulation,
+    QuadTree::Hot const& group,
+    InteractionList& list
+) {
+    QuadTree const& tree = simulation.tree;
+    Real const theta = simulation.theta;
+    list.clear();
+
+    auto const
+        firstX = tree.bodyX.begin() + group.first
+    ,   firstY = tree.bodyY.begin() + group.first
+    ;
+    auto const [minX, maxX] =
+        std::minmax_element(firstX, firstX + group.count);
+    auto const [minY, maxY] =
+        std::minmax_element(firstY, firstY + group.count);
+
+    // Same walk as `fieldAt`, but a node is only far enough when it is from
+    // every point of the group's bounding box.
+    QuadTree::Hot const *nodes = tree.hot.data();
+    QuadTree::Index const end = tree.nodeCount();
+    for (QuadTree::Index i = 0; i < end;) {
+        QuadTree::Hot const& node = nodes[i];
+        PARSIM_COUNT(list.visits++);
+        if (node.count == 0) {
+            i = node.next;
+            continue;
+        }
+        Real const
+            centerX = node.massCenter.x
+        ,   centerY = node.massCenter.y
+        ,   distX = std::max<Real>({*minX - centerX, centerX - *maxX, 0})
+        ,   distY = std::max<Real>({*minY - centerY, centerY - *maxY, 0})
+        ,   dist = std::sqrt(distX * distX + distY * distY)
+        ;
+        bool const
+            isLeaf = node.next == i + 1
+        ,   isFar = node.size / dist < theta
+        ;
+        if (isLeaf && !isFar) {
+            list.leaves.push_back({node.first, node.count});
+            i = node.next;
+            continue;
+        }
+        if (!isFar) {
+            i++;
+            continue;
+        }
+        list.cellX.push_back(node.massCenter.x);
+        list.cellY.push_back(node.massCenter.y);
+        list.cellMasses.push_back(node.mass);
+        std::array<Real, 3> const& q = tree.quadrupoles[i];
+        list.cellQxx.push_back(q[0]);
+        list.cellQxy.push_back(q[1]);
+        list.cellQyy.push_back(q[2]);
+        i = node.next;
+    }
+}
\ No newline at end of file
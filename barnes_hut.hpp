@@ -0,0 +1,127 @@
+#ifndef PARSIM_BARNES_HUT_H
+#define PARSIM_BARNES_HUT_H
+
+#include <atomic>
+
+#include "gravity_solver.hpp"
+#include "quad_tree.hpp"
+
+// Walks the tree once per body, replacing every node whose width over
+// distance is below `Simulation::theta` with its total mass (and its
+// quadrupole moment with `Simulation::quadrupoles`).
+//
+// With a `groupSize` the walk is done once per group of nearby bodies (the
+// largest nodes holding at most that many) instead, measuring the distance
+// to the bounding box of the group. The accepted nodes and the opened leaves
+// go into an interaction list that every body of the group then sums up.
+//
+// Split into far and near, the accepted nodes are far and the bodies of the
+// opened leaves are near. The split is always done per group, per leaf with
+// a `groupSize` of 0, and remembers each group's near bodies so the near
+// field can be summed again after they moved, without a new tree.
+class BarnesHutSolver : public GravitySolver {
+public:
+    // 0 walks the tree for every body
+    size_t groupSize;
+
+    explicit BarnesHutSolver(size_t _groupSize = 0);
+    void computeField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    ) override;
+    void computeFieldFor(
+        Simulation const& simulation,
+        std::vector<Entity> const& active,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    ) override;
+    void computeSplitField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& far,
+        std::vector<RealVec2>& near,
+        ThreadPool& pool
+    ) override;
+    void computeNearField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& near,
+        ThreadPool& pool
+    ) override;
+    bool nearFieldNeedsTree() const override;
+    // the accepted nodes and the bodies of the opened leaves
+    Interactions interactions() const override;
+    std::vector<uint32_t> const *interactionsPerBody() const override;
+
+private:
+    // what a group of bodies interacts with, in SoA columns
+    struct InteractionList {
+        std::vector<Real> cellX;
+        std::vector<Real> cellY;
+        std::vector<Real> cellMasses;
+        std::vector<Real> cellQxx;
+        std::vector<Real> cellQxy;
+        std::vector<Real> cellQyy;
+        //                     [ first, count ] in `QuadTree::bodies`
+        std::vector<std::pair<QuadTree::Index, QuadTree::Index>> leaves;
+        // nodes the walk looked at
+        size_t visits;
+
+        void clear();
+    };
+
+    // the bodies a group sums directly, by entity since the tree is rebuilt
+    // before they are used again
+    struct NearList {
+        std::vector<Entity> targets;
+        std::vector<Entity> sources;
+        std::vector<Real> sourceMasses;
+    };
+
+    std::atomic<size_t> cellInteractions{0};
+    std::atomic<size_t> bodyInteractions{0};
+    std::atomic<size_t> nodeVisits{0};
+    // by entity, see `interactionsPerBody`
+    std::vector<uint32_t> perBody;
+    std::vector<QuadTree::Index> groups;
+    // per entity, whether it's in the `active` of `computeFieldFor`
+    std::vector<char> activeFlags;
+    // one per group of the last `computeSplitField`
+    std::vector<NearList> nearLists;
+
+    // the largest nodes with at most `groupSize` bodies, or the leaves
+    void collectGroups(QuadTree const& tree);
+
+    // every body with a null `active`
+    void computeBodyField(
+        Simulation const& simulation,
+        std::vector<Entity> const *active,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    );
+    // every body with a null `activeFlags`
+    void computeGroupField(
+        Simulation const& simulation,
+        std::vector<char> const *activeFlags,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    );
+    // `computeNearField` without clearing the counts
+    void sumNearField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& near,
+        ThreadPool& pool
+    );
+    static void buildInteractionList(
+        Simulation const& simulation,
+        QuadTree::Hot const& group,
+        InteractionList& list
+    );
+
+    static RealVec2 fieldAt(
+        Simulation const& simulation,
+        Entity e,
+        Interactions& counts
+    );
+};
+
+#endif /* PARSIM_BARNES_HUT_H */
\ No newline at end of file
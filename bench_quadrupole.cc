@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include "simulation.hpp"
+#include "barnes_hut.hpp"
+#include "world.hpp"
+
+// Compares the Barnes-Hut walk with and without quadrupole moments: for a
+// range of `theta` it prints the interactions per body next to the relative
+// force error against a direct O(N^2) sum.
+//
+//   usage: bench-quadrupole [bodies.csv] [leaf capacity]
+
+namespace {
+std::vector<BasicVec2<double>> directForces(Simulation const& simulation) {
+    size_t const n = simulation.size();
+    BodyStore<Real> const& bodies = simulation.bodies;
+    std::vector<BasicVec2<double>> forces(n);
+    for (size_t i = 0; i < n; i++) {
+        double fx = 0., fy = 0.;
+        for (size_t j = 0; j < n; j++) {
+            double const
+                dx = double(bodies.x[j]) - bodies.x[i]
+            ,   dy = double(bodies.y[j]) - bodies.y[i]
+            ,   r2 = dx * dx + dy * dy
+            ;
+            if (r2 == 0.) {
+                continue;
+            }
+            double const w = bodies.masses[j] / (r2 * std::sqrt(r2));
+            fx += w * dx;
+            fy += w * dy;
+        }
+        double const scale = double(simulation.gamma) * bodies.masses[i];
+        forces[i] = {fx * scale, fy * scale};
+    }
+    return forces;
+}
+
+// [ median, 99th percentile ] of the relative error
+std::pair<double, double> forceErrors(
+    std::vector<RealVec2> const& forces,
+    std::vector<BasicVec2<double>> const& reference
+) {
+    std::vector<double> errors;
+    for (size_t e = 0; e < forces.size(); e++) {
+        double const expected = abs(reference[e]);
+        if (expected > 0.) {
+            errors.push_back(
+                abs(vec2Cast<double>(forces[e]) - reference[e]) / expected
+            );
+        }
+    }
+    if (errors.empty()) {
+        return {0., 0.};
+    }
+    std::sort(errors.begin(), errors.end());
+    return {errors[errors.size() / 2], errors[errors.size() * 99 / 100]};
+}
+}
+
+int main(int argc, char **argv) {
+    char const *bodiesPath = argc > 1 ? argv[1] : "bodies.csv";
+    size_t const leafCapacity =
+        argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8;
+
+    Simulation simulation = World::create(
+        World::defaultScreen,
+        0.5f,
+        QuadTree::BuildMode::morton
+    );
+    simulation.tree.leafCapacity = leafCapacity;
+    auto solver = std::make_unique<BarnesHutSolver>();
+    BarnesHutSolver const& barnesHut = *solver;
+    simulation.setSolver(std::move(solver));
+    // centered on the pointer like every other front end
+    if (!World::load({bodiesPath}, simulation)) {
+        return 1;
+    }
+    if (simulation.size() == 0) {
+        return 0;
+    }
+
+    std::vector<BasicVec2<double>> const reference =
+        directForces(simulation);
+    std::printf(
+        "%6s %11s %16s %12s %12s\n",
+        "theta", "quadrupoles", "interactions/body", "median err", "p99 err"
+    );
+    for (float theta : {0.3f, 0.5f, 0.7f, 0.9f, 1.1f}) {
+        for (bool quadrupoles : {false, true}) {
+            simulation.theta = theta;
+            simulation.quadrupoles = quadrupoles;
+            simulation.computeForces();
+            auto const interactions = barnesHut.interactions();
+            auto const errors = forceErrors(simulation.forces, reference);
+            std::printf(
+                "%6.2f %11s %17.1f %12.3e %12.3e\n",
+                theta,
+                quadrupoles ? "yes" : "no",
+                double(interactions.cells + interactions.bodies)
+                    / simulation.size(),
+                errors.first,
+                errors.second
+            );
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "simulation.hpp"
+#include "barnes_hut.hpp"
+#include "fmm.hpp"
+#include "generators.hpp"
+#include "world.hpp"
+
+// Runs the step loop on generated bodies of growing count and prints the
+// time per update next to the exponent of its growth, between each count
+// and the one before and fitted over all of them. Barnes-Hut and FMM should
+// stay close to 1 (N log N), a direct sum goes to 2.
+//
+// The generator's radius grows with the square root of the count, so the
+// mean spacing between bodies stays the same.
+
+namespace {
+struct Options {
+    Generator::Layout layout = Generator::Layout::plummer;
+    size_t minCount = 1000;
+    size_t maxCount = 10000000;
+    double factor = 10.;
+    size_t steps = 3;
+    size_t substeps = 1;
+    float dt = 1.f / 200.f;
+    size_t threads = ThreadPool::defaultThreadCount();
+    QuadTree::BuildMode buildMode = QuadTree::BuildMode::morton;
+    size_t leafCapacity = 8;
+    std::string solver = "barnes-hut";
+    size_t groupSize = 0;
+    uint64_t seed = 1;
+    // seconds per update, larger counts are skipped once an update takes
+    // longer
+    double budget = 30.;
+};
+
+struct Row {
+    size_t count;
+    double seconds;
+};
+
+void usage(char const *argv0) {
+    std::cerr
+        <<"usage: "<<argv0<<" [options]"<<std::endl
+        <<"  --layout uniform-disk|plummer|exponential-disk|clusters"
+        <<std::endl
+        <<"                             generated bodies (plummer)"
+        <<std::endl
+        <<"  --min N                    first body count (1000)"<<std::endl
+        <<"  --max N                    last body count (10000000)"
+        <<std::endl
+        <<"  --factor F                 count growth per row (10)"
+        <<std::endl
+        <<"  --steps N                  timed updates per count (3)"
+        <<std::endl
+        <<"  --substeps N               integrator steps per update (1)"
+        <<std::endl
+        <<"  --dt SECONDS               time per update (0.005)"<<std::endl
+        <<"  --threads N                force phase threads (all cores)"
+        <<std::endl
+        <<"  --build incremental|morton quad tree construction (morton)"
+        <<std::endl
+        <<"  --leaf-capacity N          bodies per quad tree leaf (8)"
+        <<std::endl
+        <<"  --solver barnes-hut|fmm    gravity solver (barnes-hut)"
+        <<std::endl
+        <<"  --group-size N             Barnes-Hut group size (0)"
+        <<std::endl
+        <<"  --seed N                   generator seed (1)"<<std::endl
+        <<"  --budget SECONDS           stop after an update takes longer"
+        <<std::endl
+        <<"                             (30)"<<std::endl;
+}
+
+bool parseOptions(int argc, char **argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string const arg = argv[i];
+        bool const hasValue = i + 1 < argc;
+        if (arg == "--layout" && hasValue) {
+            if (!Generator::parseLayout(argv[++i], options.layout)) {
+                return false;
+            }
+        } else if (arg == "--min" && hasValue) {
+            options.minCount = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--max" && hasValue) {
+            options.maxCount = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--factor" && hasValue) {
+            options.factor = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--steps" && hasValue) {
+            options.steps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--substeps" && hasValue) {
+            options.substeps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--dt" && hasValue) {
+            options.dt = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--build" && hasValue) {
+            std::string const mode = argv[++i];
+            if (mode == "incremental") {
+                options.buildMode = QuadTree::BuildMode::incremental;
+            } else if (mode == "morton") {
+                options.buildMode = QuadTree::BuildMode::morton;
+            } else {
+                return false;
+            }
+        } else if (arg == "--leaf-capacity" && hasValue) {
+            options.leafCapacity = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--solver" && hasValue) {
+            options.solver = argv[++i];
+            if (options.solver != "barnes-hut" && options.solver != "fmm") {
+                return false;
+            }
+        } else if (arg == "--group-size" && hasValue) {
+            options.groupSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--budget" && hasValue) {
+            options.budget = std::strtod(argv[++i], nullptr);
+        } else {
+            return false;
+        }
+    }
+    return options.minCount > 0
+        && options.maxCount >= options.minCount
+        && options.factor > 1.
+        && options.steps > 0;
+}
+
+// seconds per update, after one untimed update
+double timeUpdates(Options const& options, size_t count) {
+    Generator generator;
+    generator.layout = options.layout;
+    generator.count = count;
+    generator.seed = options.seed;
+    generator.radius = 30. * std::sqrt(double(count));
+
+    // a little room around the generated bodies
+    float const half = 1.1f * generator.radius;
+    Rect viewport;
+    viewport.x = -half;
+    viewport.y = -half;
+    viewport.width = 2.f * half;
+    viewport.height = 2.f * half;
+    Simulation simulation(
+        World::materials(),
+        viewport,
+        0.5f,
+        {0.f, 0.f},
+        options.buildMode
+    );
+    simulation.setThreadCount(options.threads);
+    simulation.tree.leafCapacity = options.leafCapacity;
+    simulation.substeps = options.substeps;
+    if (options.solver == "fmm") {
+        simulation.setSolver(std::make_unique<FmmSolver>());
+    } else {
+        simulation.setSolver(
+            std::make_unique<BarnesHutSolver>(options.groupSize)
+        );
+    }
+    generator.addTo(simulation);
+
+    simulation.update(options.dt);
+    auto const start = std::chrono::steady_clock::now();
+    for (size_t step = 0; step < options.steps; step++) {
+        simulation.update(options.dt);
+    }
+    std::chrono::duration<double> const elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / options.steps;
+}
+
+// slope of log(seconds) over log(count), least squares
+double fitExponent(std::vector<Row> const& rows) {
+    double sx = 0., sy = 0., sxx = 0., sxy = 0.;
+    for (Row const& row : rows) {
+        double const
+            x = std::log(double(row.count))
+        ,   y = std::log(row.seconds)
+        ;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    double const n = rows.size();
+    return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::printf(
+        "layout: %s, solver: %s, threads: %zu, substeps: %zu\n",
+        Generator::layoutName(options.layout),
+        options.solver.c_str(),
+        options.threads,
+        options.substeps
+    );
+    std::printf(
+        "%10s %12s %14s %10s\n",
+        "bodies", "ms/update", "ns/body/update", "exponent"
+    );
+    std::vector<Row> rows;
+    for (
+        double next = options.minCount;
+        std::llround(next) <= (long long)options.maxCount;
+        next *= options.factor
+    ) {
+        size_t const count = std::llround(next);
+        double const seconds = timeUpdates(options, count);
+        std::printf(
+            "%10zu %12.2f %14.1f",
+            count,
+            seconds * 1e3,
+            seconds * 1e9 / count
+        );
+        if (rows.empty()) {
+            std::printf(" %10s\n", "-");
+        } else {
+            Row const& last = rows.back();
+            std::printf(
+                " %10.2f\n",
+                std::log(seconds / last.seconds)
+                    / std::log(double(count) / last.count)
+            );
+        }
+        std::fflush(stdout);
+        rows.push_back({count, seconds});
+        if (seconds > options.budget) {
+            std::printf(
+                "stopping, an update took over %g s\n",
+                options.budget
+            );
+            break;
+        }
+    }
+    if (rows.size() > 1) {
+        std::printf("fitted exponent: %.2f\n", fitExponent(rows));
+    }
+    return 0;
+}
\ No newline at end of file
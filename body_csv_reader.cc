@@ -1,69 +1,308 @@
-#include <sstream>
-#include <iomanip>
-#include <type_traits>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <vector>
 
 #include "body_csv_reader.hpp"
-#include "util.hpp"
+#include "thread_pool.hpp"
 
 namespace {
-class RowParser {
-public:
-    RowParser(std::istream& _is) : is(_is) {}
-    template <bool Skip = true, typename T>
-    RowParser& readColumn(T& v) {
-        if constexpr (std::is_base_of<std::basic_string<char>, T>::value) {
-            std::getline(is, v, ',');
-        } else {
-            is>>v;
-            if constexpr (Skip) {
-                is.ignore(1);
-            }
+using Status = BodyCSVReader::Status;
+
+size_t constexpr fieldCount = 7;
+// fewer bytes aren't worth a chunk of their own
+size_t constexpr minChunkBytes = 64 * 1024;
+// per thread, so uneven chunks even out
+size_t constexpr chunksPerThread = 8;
+
+// FNV-1a
+constexpr uint32_t nameHash(std::string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash = (hash ^ uint8_t(c)) * 16777619u;
+    }
+    return hash;
+}
+
+// A switch over the hashes of the palette names, so a name costs a hash and
+// one comparison. Two names with the same hash wouldn't compile.
+bool namedColor(std::string_view name, Rgba& color) {
+#define PARSIM_COLOR(NAME) \
+    case nameHash(#NAME): \
+        if (name != #NAME) { \
+            return false; \
+        } \
+        color = palette::NAME; \
+        return true;
+
+    switch (nameHash(name)) {
+    PARSIM_COLOR(lightgray)
+    PARSIM_COLOR(gray)
+    PARSIM_COLOR(darkgray)
+    PARSIM_COLOR(yellow)
+    PARSIM_COLOR(gold)
+    PARSIM_COLOR(orange)
+    PARSIM_COLOR(pink)
+    PARSIM_COLOR(red)
+    PARSIM_COLOR(maroon)
+    PARSIM_COLOR(green)
+    PARSIM_COLOR(lime)
+    PARSIM_COLOR(darkgreen)
+    PARSIM_COLOR(skyblue)
+    PARSIM_COLOR(blue)
+    PARSIM_COLOR(darkblue)
+    PARSIM_COLOR(purple)
+    PARSIM_COLOR(violet)
+    PARSIM_COLOR(darkpurple)
+    PARSIM_COLOR(beige)
+    PARSIM_COLOR(brown)
+    PARSIM_COLOR(darkbrown)
+
+    PARSIM_COLOR(white)
+    PARSIM_COLOR(black)
+    PARSIM_COLOR(blank)
+    PARSIM_COLOR(magenta)
+    PARSIM_COLOR(raywhite)
+    }
+    return false;
+
+#undef PARSIM_COLOR
+}
+
+bool hexByte(char const *digits, uint8_t& byte) {
+    unsigned value = 0;
+    auto const [end, error] = std::from_chars(digits, digits + 2, value, 16);
+    byte = uint8_t(value);
+    return error == std::errc() && end == digits + 2;
+}
+
+std::string_view trim(std::string_view field) {
+    auto const isSpace = [](char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    };
+    while (!field.empty() && isSpace(field.front())) {
+        field.remove_prefix(1);
+    }
+    while (!field.empty() && isSpace(field.back())) {
+        field.remove_suffix(1);
+    }
+    return field;
+}
+
+template <typename T>
+bool parseNumber(std::string_view field, T& value) {
+    field = trim(field);
+    char const *end = field.data() + field.size();
+    auto const result = std::from_chars(field.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+// the line starting at `at`, without its '\n', and moves `at` past it
+std::string_view nextLine(std::string_view text, size_t& at) {
+    size_t const newline = std::min(text.find('\n', at), text.size());
+    std::string_view const line = text.substr(at, newline - at);
+    at = std::min(newline + 1, text.size());
+    return line;
+}
+
+Status parseRow(std::string_view line, Simulation& simulation, Entity e) {
+    std::string_view fields[fieldCount];
+    size_t count = 0;
+    for (size_t start = 0;;) {
+        if (count == fieldCount) {
+            return Status::badRow;
         }
-        return *this;
+        size_t const comma = line.find(',', start);
+        fields[count++] = line.substr(start, comma - start);
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    if (count != fieldCount) {
+        return Status::badRow;
+    }
+
+    BodyStore<Real>& bodies = simulation.bodies;
+    Real radius;
+    size_t material;
+    if (
+        !parseNumber(fields[0], bodies.x[e])
+    ||  !parseNumber(fields[1], bodies.y[e])
+    ||  !parseNumber(fields[2], bodies.vx[e])
+    ||  !parseNumber(fields[3], bodies.vy[e])
+    ||  !parseNumber(fields[4], radius)
+    ||  !parseNumber(fields[6], material)
+    ) {
+        return Status::badRow;
     }
-private:
-    std::istream& is;
+    if (!BodyCSVReader::parseColor(trim(fields[5]), simulation.colors[e])) {
+        return Status::unknownColor;
+    }
+    if (material >= simulation.materialsTable.size()) {
+        return Status::unknownMaterial;
+    }
+    bodies.radii[e] = radius;
+    bodies.masses[e] = simulation.massOf(radius, material);
+    simulation.materials[e] = material;
+    return Status::ok;
+}
+
+struct Chunk {
+    std::string_view text;
+    size_t lines = 0;
+    // lines that aren't blank
+    size_t rows = 0;
+    size_t firstLine = 0;
+    Entity firstBody = 0;
+    Status status = Status::ok;
+    // of the chunk, from 0
+    size_t badLine = 0;
 };
+
+bool isBlank(std::string_view line) {
+    return trim(line).empty();
 }
 
-BodyCSVReader::BodyCSVReader(std::istream& _in) : in(_in) {}
+// Cuts `text` into about `count` pieces that each end after a '\n'.
+std::vector<Chunk> splitLines(std::string_view text, size_t count) {
+    std::vector<Chunk> chunks;
+    size_t begin = 0;
+    for (size_t i = 1; i <= count && begin < text.size(); i++) {
+        size_t end = text.size() * i / count;
+        if (i < count) {
+            end = std::max(end, begin);
+            end = std::min(text.find('\n', end), text.size());
+            end = std::min(end + 1, text.size());
+        }
+        Chunk chunk;
+        chunk.text = text.substr(begin, end - begin);
+        chunks.push_back(chunk);
+        begin = end;
+    }
+    return chunks;
+}
+}
 
-void BodyCSVReader::readInto(Simulation& simulation) {
-    // ignore the first row with the column names
-    // btw the column names are
-    // posx,posy,velx,vely,radius,color,material
-    in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-    for (;;) {
-        if (in.eof()) {
-            break;
+BodyCSVReader::BodyCSVReader(std::istream& in) : opened(in.good()) {
+    if (opened) {
+        buffer.assign(
+            std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>()
+        );
+    }
+    text = buffer;
+}
+
+BodyCSVReader::BodyCSVReader(char const *path)
+: file(std::make_unique<MappedFile>(path))
+, text(file->text())
+, opened(file->isOpen()) {}
+
+BodyCSVReader::Status BodyCSVReader::readInto(Simulation& simulation) {
+    badLine = 0;
+    if (!opened) {
+        return Status::cannotOpen;
+    }
+    size_t at = 0;
+    // the column names
+    nextLine(text, at);
+    std::string_view const rows = text.substr(at);
+
+    ThreadPool pool(simulation.threadCount());
+    size_t const chunkCount = std::clamp(
+        rows.size() / minChunkBytes,
+        size_t(1),
+        pool.size() * chunksPerThread
+    );
+    std::vector<Chunk> chunks = splitLines(rows, chunkCount);
+
+    // The rows are counted first so every chunk knows where its bodies go
+    // and can parse them in place.
+    pool.parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            Chunk& chunk = chunks[c];
+            for (size_t at = 0; at < chunk.text.size();) {
+                chunk.lines++;
+                chunk.rows += !isBlank(nextLine(chunk.text, at));
+            }
         }
-        Vector2
-            position
-        ,   velocity
-        ;
-        float radius;
-        Color color;
-        std::string colorDesc;
-        size_t material;
-        RowParser(in)
-            .readColumn(position.x)
-            .readColumn(position.y)
-            .readColumn(velocity.x)
-            .readColumn(velocity.y)
-            .readColumn(radius)
-            .readColumn(colorDesc)
-            .readColumn(material);
-        if (colorDesc[0] == '#') {
-            std::istringstream ss(colorDesc);
-            ss.ignore(1);
-            ss
-                >>std::setw(2)>>color.r
-                >>std::setw(2)>>color.g
-                >>std::setw(2)>>color.b
-                >>std::setw(2)>>color.a;
-        } else {
-            color = colorMap[colorDesc];
+    });
+    Entity const first = simulation.size();
+    Entity body = first;
+    size_t line = 0;
+    for (Chunk& chunk : chunks) {
+        chunk.firstBody = body;
+        chunk.firstLine = line;
+        body += chunk.rows;
+        line += chunk.lines;
+    }
+    simulation.resize(body);
+
+    pool.parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            Chunk& chunk = chunks[c];
+            Entity e = chunk.firstBody;
+            size_t index = 0;
+            for (size_t at = 0; at < chunk.text.size(); index++) {
+                std::string_view const row = nextLine(chunk.text, at);
+                if (isBlank(row)) {
+                    continue;
+                }
+                chunk.status = parseRow(row, simulation, e++);
+                if (chunk.status != Status::ok) {
+                    chunk.badLine = index;
+                    break;
+                }
+            }
+        }
+    });
+    for (Chunk const& chunk : chunks) {
+        if (chunk.status != Status::ok) {
+            simulation.resize(first);
+            // the column names are line 1
+            badLine = 2 + chunk.firstLine + chunk.badLine;
+            return chunk.status;
         }
-        simulation.add(position, velocity, radius, color, material);
     }
+    return Status::ok;
+}
+
+size_t BodyCSVReader::errorLine() const {
+    return badLine;
+}
+
+bool BodyCSVReader::parseColor(std::string_view description, Rgba& color) {
+    if (description.empty() || description[0] != '#') {
+        return namedColor(description, color);
+    }
+    description.remove_prefix(1);
+    if (description.size() != 6 && description.size() != 8) {
+        return false;
+    }
+    color.a = 255;
+    uint8_t *channels[] = {&color.r, &color.g, &color.b, &color.a};
+    for (size_t i = 0; i < description.size() / 2; i++) {
+        if (!hexByte(description.data() + 2 * i, *channels[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+char const *BodyCSVReader::describe(Status status) {
+    switch (status) {
+    case Status::ok:
+        return "ok";
+    case Status::cannotOpen:
+        return "could not open the file";
+    case Status::badRow:
+        return "a row isn't seven fields of numbers and a color";
+    case Status::unknownColor:
+        return "unknown color";
+    case Status::unknownMaterial:
+        return "a body's material isn't in the materials table";
+    }
+    return "unknown error";
 }
\ No newline at end of file
@@ -1,45 +1,53 @@
 #ifndef PARSIM_BODY_CSV_READER_H
 #define PARSIM_BODY_CSV_READER_H
 #include <iostream>
-#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
 
 #include "simulation.hpp"
+#include "mapped_file.hpp"
 
+// Reads bodies from csv rows of
+//   posx,posy,velx,vely,radius,color,material
+// after a first row with the column names. The color is a name from
+// `palette` or #rrggbb or #rrggbbaa in hex.
+//
+// The text is split into line-aligned chunks that are parsed on all of the
+// simulation's threads, straight into the columns of the simulation.
 class BodyCSVReader {
 public:
-    BodyCSVReader(std::istream& _in);
-    void readInto(Simulation& simulation);
-private:
-    std::istream& in;
-    std::map<std::string_view, Color> colorMap = {
-        {"lightgray", LIGHTGRAY},
-        {"gray", GRAY},
-        {"darkgray", DARKGRAY},
-        {"yellow", YELLOW},
-        {"gold", GOLD},
-        {"orange", ORANGE},
-        {"pink", PINK},
-        {"red", RED},
-        {"maroon", MAROON},
-        {"green", GREEN},
-        {"lime", LIME},
-        {"darkgreen", DARKGREEN},
-        {"skyblue", SKYBLUE},
-        {"blue", BLUE},
-        {"darkblue", DARKBLUE},
-        {"purple", PURPLE},
-        {"violet", VIOLET},
-        {"darkpurple", DARKPURPLE},
-        {"beige", BEIGE},
-        {"brown", BROWN},
-        {"darkbrown", DARKBROWN},
-
-        {"white", WHITE},
-        {"black", BLACK},
-        {"blank", BLANK},
-        {"magenta", MAGENTA},
-        {"raywhite", RAYWHITE},
+    enum class Status {
+        ok,
+        cannotOpen,
+        // not seven fields, or a field that isn't a number where one should
+        // be
+        badRow,
+        unknownColor,
+        // a material index past the end of the simulation's table
+        unknownMaterial,
     };
+
+    // reads the whole stream into memory first
+    explicit BodyCSVReader(std::istream& in);
+    // maps the file instead of copying it
+    explicit BodyCSVReader(char const *path);
+    // Appends the bodies to `simulation`. Nothing is added if any row is
+    // wrong, `errorLine` is then the first wrong one.
+    Status readInto(Simulation& simulation);
+    // counting the column names as line 1
+    size_t errorLine() const;
+
+    // a name from `palette` or #rrggbb or #rrggbbaa
+    static bool parseColor(std::string_view description, Rgba& color);
+    static char const *describe(Status status);
+
+private:
+    std::unique_ptr<MappedFile> file;
+    std::string buffer;
+    std::string_view text;
+    bool opened = true;
+    size_t badLine = 0;
 };
 
 #endif /* PARSIM_BODY_CSV_READER_H */
\ No newline at end of file
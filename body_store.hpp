@@ -0,0 +1,127 @@
+#ifndef PARSIM_BODY_STORE_H
+#define PARSIM_BODY_STORE_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+
+// Storage aligned to `Alignment` bytes, so every column starts on a cache
+// line.
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(AlignedAllocator<U, Alignment> const&) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(
+            ::operator new(n * sizeof(T), std::align_val_t(Alignment))
+        );
+    }
+    void deallocate(T *p, size_t) {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+    template <typename U>
+    bool operator==(AlignedAllocator<U, Alignment> const&) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(AlignedAllocator<U, Alignment> const&) const {
+        return false;
+    }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Drops the entries of a column whose `dead` flag is set and moves the others
+// down, keeping their order.
+template <typename Column>
+void compactColumn(Column& column, std::vector<char> const& dead) {
+    size_t kept = 0;
+    for (size_t i = 0; i < column.size(); i++) {
+        if (!dead[i]) {
+            column[kept++] = std::move(column[i]);
+        }
+    }
+    column.resize(kept);
+}
+
+// The physical state of the bodies, a column per quantity, indexed by
+// entity. The mass is worked out once when a body is added instead of from
+// radius and density whenever a force is computed.
+template <typename Scalar>
+class BodyStore {
+public:
+    using Vec = BasicVec2<Scalar>;
+
+    AlignedVector<Scalar> x;
+    AlignedVector<Scalar> y;
+    AlignedVector<Scalar> vx;
+    AlignedVector<Scalar> vy;
+    AlignedVector<Scalar> masses;
+    AlignedVector<Scalar> radii;
+
+    size_t size() const {
+        return x.size();
+    }
+    void add(Vec position, Vec velocity, Scalar radius, Scalar mass) {
+        x.push_back(position.x);
+        y.push_back(position.y);
+        vx.push_back(velocity.x);
+        vy.push_back(velocity.y);
+        masses.push_back(mass);
+        radii.push_back(radius);
+    }
+    void clear() {
+        x.clear();
+        y.clear();
+        vx.clear();
+        vy.clear();
+        masses.clear();
+        radii.clear();
+    }
+    // new bodies are all zeros
+    void resize(size_t n) {
+        x.resize(n);
+        y.resize(n);
+        vx.resize(n);
+        vy.resize(n);
+        masses.resize(n);
+        radii.resize(n);
+    }
+    // removes the bodies flagged in `dead`, renumbering the others in order
+    void compact(std::vector<char> const& dead) {
+        compactColumn(x, dead);
+        compactColumn(y, dead);
+        compactColumn(vx, dead);
+        compactColumn(vy, dead);
+        compactColumn(masses, dead);
+        compactColumn(radii, dead);
+    }
+    Vec position(Entity e) const {
+        return {x[e], y[e]};
+    }
+    Vec velocity(Entity e) const {
+        return {vx[e], vy[e]};
+    }
+    void setPosition(Entity e, Vec position) {
+        x[e] = position.x;
+        y[e] = position.y;
+    }
+    void setVelocity(Entity e, Vec velocity) {
+        vx[e] = velocity.x;
+        vy[e] = velocity.y;
+    }
+};
+
+#endif /* PARSIM_BODY_STORE_H */
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "simulation.hpp"
+#include "draw_list.hpp"
+#include "fmm.hpp"
+#include "world.hpp"
+
+// Checks of results no window or timing shows, on small layouts built here.
+// Prints a line per check and exits non-zero when any fails.
+//
+//   usage: parsim-check [check...]
+//
+// runs every check when none is named.
+
+namespace {
+struct Check {
+    char const *name;
+    std::function<bool()> run;
+};
+
+// relative to the largest force, so bodies that are pulled about equally
+// from all sides don't blow it up
+double maxError(
+    std::vector<RealVec2> const& forces,
+    std::vector<RealVec2> const& reference
+) {
+    double largest = 0., error = 0.;
+    for (size_t e = 0; e < forces.size(); e++) {
+        largest = std::max(largest, double(abs(reference[e])));
+        error = std::max(
+            error,
+            double(abs(forces[e] - reference[e]))
+        );
+    }
+    return largest > 0. ? error / largest : error;
+}
+
+bool allFinite(std::vector<RealVec2> const& forces) {
+    for (RealVec2 const& f : forces) {
+        if (!std::isfinite(f.x) || !std::isfinite(f.y)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A grid of bodies and two close ones in it, which then move apart, far
+// enough to leave their subtree empty but not for a rebuild.
+void addGridAndPair(Simulation& simulation) {
+    RealVec2 const origin = vec2Cast<Real>(simulation.pointer);
+    for (int i = 0; i < 10; i++) {
+        for (int j = 0; j < 10; j++) {
+            simulation.add(
+                origin + RealVec2 {Real(i * 50), Real(j * 50)},
+                {0, 0},
+                1,
+                palette::skyblue,
+                0
+            );
+        }
+    }
+    simulation.add(origin + RealVec2 {480, 480}, {0, 0}, 1, palette::red, 0);
+    simulation.add(origin + RealVec2 {481, 480}, {0, 0}, 1, palette::red, 0);
+}
+
+void moveThePairApart(Simulation& simulation) {
+    RealVec2 const origin = vec2Cast<Real>(simulation.pointer);
+    Entity const a = simulation.size() - 2;
+    simulation.bodies.setPosition(a, origin + RealVec2 {600, -300});
+    simulation.bodies.setPosition(a + 1, origin + RealVec2 {-300, 600});
+}
+
+// FMM on a refit tree gives the forces of a fresh build.
+bool refitThenFmm() {
+    std::vector<RealVec2> forces[2];
+    for (bool refit : {false, true}) {
+        Simulation simulation = World::create();
+        simulation.refitTree = refit;
+        simulation.setSolver(std::make_unique<FmmSolver>());
+        addGridAndPair(simulation);
+        simulation.computeForces();
+        moveThePairApart(simulation);
+        simulation.computeForces();
+        forces[refit] = simulation.forces;
+    }
+    if (!allFinite(forces[true])) {
+        std::printf("  forces that aren't finite\n");
+        return false;
+    }
+    double const error = maxError(forces[true], forces[false]);
+    std::printf("  max difference from a fresh build: %.2e\n", error);
+    return error < 1e-5;
+}
+
+// A 10x10 grid 50 apart from the pointer on, radius 2, seen through
+// `selectDrawList`: at full size only what's on a 200x200 screen over its
+// corner is left, 5x5 disks, the same as without the tree but reached
+// through fewer nodes. Zoomed out until the grid is smaller than
+// `minCellSize` it's a single splat from the root.
+bool drawListSelection() {
+    Simulation simulation = World::create();
+    RealVec2 const origin = vec2Cast<Real>(simulation.pointer);
+    for (int i = 0; i < 10; i++) {
+        for (int j = 0; j < 10; j++) {
+            simulation.add(
+                origin + RealVec2 {Real(i * 50), Real(j * 50)},
+                {0, 0},
+                2,
+                palette::skyblue,
+                0
+            );
+        }
+    }
+    simulation.buildTree();
+    RenderState state;
+    state.capture(simulation, true);
+    RenderState flat;
+    flat.capture(simulation, false);
+
+    View view = {simulation.pointer, {0.f, 0.f}, 1.f};
+    LodSettings settings;
+    settings.screen = {simulation.pointer.x, simulation.pointer.y, 200, 200};
+    settings.overlayDepth = 0;
+    DrawList list, flatList;
+    selectDrawList(state, view, settings, list);
+    selectDrawList(flat, view, settings, flatList);
+    std::printf(
+        "  culled: %zu disks, %zu splats, %zu of %zu nodes visited,"
+        " %zu disks without the tree\n",
+        list.disks.size(),
+        list.splats.size(),
+        list.visitedNodes,
+        state.nodes.size(),
+        flatList.disks.size()
+    );
+    bool ok = list.disks.size() == 25
+        && list.splats.empty()
+        && flatList.disks.size() == 25
+        && list.outlines.size() == 1
+        && list.visitedNodes < state.nodes.size();
+
+    view.scale = 0.003f;
+    settings.screen = {0, 0, 900, 700};
+    selectDrawList(state, view, settings, list);
+    std::printf(
+        "  zoomed out: %zu disks, %zu splats, %zu nodes visited\n",
+        list.disks.size(),
+        list.splats.size(),
+        list.visitedNodes
+    );
+    return ok
+        && list.disks.empty()
+        && list.splats.size() == 1
+        && list.visitedNodes == 1;
+}
+
+std::vector<Check> const checks = {
+    {"refit-fmm", refitThenFmm},
+    {"draw-list", drawListSelection},
+};
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> const names(argv + 1, argv + argc);
+    bool failed = false;
+    size_t ran = 0;
+    for (Check const& check : checks) {
+        bool const wanted = names.empty()
+            || std::find(names.begin(), names.end(), check.name)
+                != names.end();
+        if (!wanted) {
+            continue;
+        }
+        std::printf("%s\n", check.name);
+        bool const ok = check.run();
+        std::printf("%s: %s\n", check.name, ok ? "ok" : "FAILED");
+        failed = failed || !ok;
+        ran++;
+    }
+    if (ran < names.size()) {
+        std::fprintf(stderr, "unknown check, there are:");
+        for (Check const& check : checks) {
+            std::fprintf(stderr, " %s", check.name);
+        }
+        std::fprintf(stderr, "\n");
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
\ No newline at end of file
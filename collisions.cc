@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <limits>
+
+#include "collisions.hpp"
+#include "simulation.hpp"
+
+bool CollisionFinder::Box::overlaps(Box const& other) const {
+    return minX <= other.maxX
+        && other.minX <= maxX
+        && minY <= other.maxY
+        && other.minY <= maxY;
+}
+
+std::vector<CollisionFinder::Pair> const& CollisionFinder::find(
+    Simulation const& simulation,
+    ThreadPool& pool
+) {
+    pairs.clear();
+    QuadTree const& tree = simulation.tree;
+    BodyStore<Real> const& bodies = simulation.bodies;
+    if (tree.bodies.size() != bodies.size()) {
+        return pairs;
+    }
+    computeBoxes(simulation);
+
+    // Every body looks for partners with a larger entity, so each pair is
+    // found once.
+    pool.parallelFor(
+        tree.bodies.size(),
+        simulation.forceChunkSize,
+        [&](size_t begin, size_t end) {
+            std::vector<Pair> found;
+            QuadTree::Hot const *nodes = tree.hot.data();
+            QuadTree::Index const nodeCount = tree.nodeCount();
+            for (size_t k = begin; k < end; k++) {
+                Entity const e = tree.bodies[k];
+                Real const
+                    x = bodies.x[e]
+                ,   y = bodies.y[e]
+                ,   r = bodies.radii[e]
+                ;
+                Box const box = {x - r, y - r, x + r, y + r};
+                for (QuadTree::Index i = 0; i < nodeCount;) {
+                    QuadTree::Hot const& node = nodes[i];
+                    if (node.count == 0 || !boxes[i].overlaps(box)) {
+                        i = node.next;
+                        continue;
+                    }
+                    if (node.next != i + 1) {
+                        i++;
+                        continue;
+                    }
+                    for (
+                        auto j = node.first;
+                        j < node.first + node.count;
+                        j++
+                    ) {
+                        Entity const other = tree.bodies[j];
+                        if (other <= e) {
+                            continue;
+                        }
+                        Real const
+                            dx = bodies.x[other] - x
+                        ,   dy = bodies.y[other] - y
+                        ,   reach = bodies.radii[other] + r
+                        ;
+                        if (dx * dx + dy * dy < reach * reach) {
+                            found.push_back({e, other});
+                        }
+                    }
+                    i = node.next;
+                }
+            }
+            if (!found.empty()) {
+                std::lock_guard<std::mutex> lock(pairsMutex);
+                pairs.insert(pairs.end(), found.begin(), found.end());
+            }
+        }
+    );
+    std::sort(
+        pairs.begin(),
+        pairs.end(),
+        [](Pair const& p, Pair const& q) {
+            return p.a != q.a ? p.a < q.a : p.b < q.b;
+        }
+    );
+    return pairs;
+}
+
+// bottom up like the mass moments, children come after their parent
+void CollisionFinder::computeBoxes(Simulation const& simulation) {
+    QuadTree const& tree = simulation.tree;
+    BodyStore<Real> const& bodies = simulation.bodies;
+    Real const inf = std::numeric_limits<Real>::infinity();
+    boxes.resize(tree.nodeCount());
+    for (QuadTree::Index i = tree.nodeCount(); i-- > 0;) {
+        QuadTree::Hot const& node = tree.hot[i];
+        Box box = {inf, inf, -inf, -inf};
+        if (tree.isLeaf(i)) {
+            for (auto k = node.first; k < node.first + node.count; k++) {
+                Entity const e = tree.bodies[k];
+                Real const r = bodies.radii[e];
+                box.minX = std::min(box.minX, bodies.x[e] - r);
+                box.minY = std::min(box.minY, bodies.y[e] - r);
+                box.maxX = std::max(box.maxX, bodies.x[e] + r);
+                box.maxY = std::max(box.maxY, bodies.y[e] + r);
+            }
+        } else {
+            for (QuadTree::Index const c : tree.children(i)) {
+                Box const& child = boxes[c];
+                box.minX = std::min(box.minX, child.minX);
+                box.minY = std::min(box.minY, child.minY);
+                box.maxX = std::max(box.maxX, child.maxX);
+                box.maxY = std::max(box.maxY, child.maxY);
+            }
+        }
+        boxes[i] = box;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef PARSIM_COLLISIONS_H
+#define PARSIM_COLLISIONS_H
+
+#include <mutex>
+#include <vector>
+
+#include "common.hpp"
+#include "thread_pool.hpp"
+
+class Simulation;
+
+// Finds the pairs of bodies whose disks overlap. The broad phase is the
+// simulation's quad tree: every node gets the bounding box of its bodies'
+// disks, and each body walks the tree skipping the nodes whose box misses
+// its own, so a query costs about the depth of the tree instead of a pass
+// over every other body.
+class CollisionFinder {
+public:
+    struct Pair {
+        // a < b
+        Entity a;
+        Entity b;
+    };
+
+    // The tree must hold every body, but needn't be built for the current
+    // positions: the boxes are computed from them, a stale tree only prunes
+    // less. The pairs come out sorted, whatever the number of threads.
+    std::vector<Pair> const& find(
+        Simulation const& simulation,
+        ThreadPool& pool
+    );
+
+private:
+    struct Box {
+        Real minX;
+        Real minY;
+        Real maxX;
+        Real maxY;
+
+        bool overlaps(Box const& other) const;
+    };
+
+    // per node
+    std::vector<Box> boxes;
+    std::vector<Pair> pairs;
+    std::mutex pairsMutex;
+
+    void computeBoxes(Simulation const& simulation);
+};
+
+#endif /* PARSIM_COLLISIONS_H */
\ No newline at end of file
@@ -1,6 +1,77 @@
+#ifndef PARSIM_COMMON_H
+#define PARSIM_COMMON_H
 #include <cmath>
 #include <cinttypes>
+#include <cstdint>
+#include <sys/types.h>
 
-#include <raylib.h>
+// The simulation core is built without raylib so it can run on machines
+// without a display. These mirror the layout of raylib's `Vector2`,
+// `Rectangle` and `Color`, see `raylib_bridge.hpp` for the conversions.
 
-using Entity = ssize_t;
\ No newline at end of file
+template <typename Scalar>
+struct BasicVec2 {
+    Scalar x;
+    Scalar y;
+};
+
+using Vec2 = BasicVec2<float>;
+
+struct Rect {
+    float x;
+    float y;
+    float width;
+    float height;
+};
+
+struct Rgba {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+namespace palette {
+inline constexpr Rgba
+    lightgray   = {200, 200, 200, 255}
+,   gray        = {130, 130, 130, 255}
+,   darkgray    = {80, 80, 80, 255}
+,   yellow      = {253, 249, 0, 255}
+,   gold        = {255, 203, 0, 255}
+,   orange      = {255, 161, 0, 255}
+,   pink        = {255, 109, 194, 255}
+,   red         = {230, 41, 55, 255}
+,   maroon      = {190, 33, 55, 255}
+,   green       = {0, 228, 48, 255}
+,   lime        = {0, 158, 47, 255}
+,   darkgreen   = {0, 117, 44, 255}
+,   skyblue     = {102, 191, 255, 255}
+,   blue        = {0, 121, 241, 255}
+,   darkblue    = {0, 82, 172, 255}
+,   purple      = {200, 122, 255, 255}
+,   violet      = {135, 60, 190, 255}
+,   darkpurple  = {112, 31, 126, 255}
+,   beige       = {211, 176, 131, 255}
+,   brown       = {127, 106, 79, 255}
+,   darkbrown   = {76, 63, 47, 255}
+,   white       = {255, 255, 255, 255}
+,   black       = {0, 0, 0, 255}
+,   blank       = {0, 0, 0, 0}
+,   magenta     = {255, 0, 255, 255}
+,   raywhite    = {245, 245, 245, 255}
+;
+}
+
+using Entity = ssize_t;
+
+// The precision of the body state, the tree's mass moments and the force
+// kernels. Float for throughput, double (-DPARSIM_DOUBLE, `CONFIG_DOUBLE=y`
+// for tup) for long integrations that float would let drift.
+#ifdef PARSIM_DOUBLE
+using Real = double;
+#else
+using Real = float;
+#endif
+using RealVec2 = BasicVec2<Real>;
+
+#endif /* PARSIM_COMMON_H */
\ No newline at end of file
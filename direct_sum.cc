@@ -0,0 +1,72 @@
+#include <algorithm>
+
+#include "direct_sum.hpp"
+#include "kernels.hpp"
+#include "simulation.hpp"
+
+DirectSumSolver::DirectSumSolver(size_t _tileSize)
+: tileSize(std::max<size_t>(_tileSize, 1)) {}
+
+void DirectSumSolver::computeField(
+    Simulation const& simulation,
+    std::vector<RealVec2>& field,
+    ThreadPool& pool
+) {
+    sum(simulation, nullptr, field, pool);
+}
+
+void DirectSumSolver::computeFieldFor(
+    Simulation const& simulation,
+    std::vector<Entity> const& active,
+    std::vector<RealVec2>& field,
+    ThreadPool& pool
+) {
+    sum(simulation, &active, field, pool);
+}
+
+GravitySolver::Interactions DirectSumSolver::interactions() const {
+    return {0, bodyInteractions, 0};
+}
+
+void DirectSumSolver::sum(
+    Simulation const& simulation,
+    std::vector<Entity> const *active,
+    std::vector<RealVec2>& field,
+    ThreadPool& pool
+) {
+    BodyStore<Real> const& bodies = simulation.bodies;
+    size_t const
+        n = simulation.size()
+    ,   targets = active ? active->size() : n
+    ;
+    double const gamma = simulation.gamma;
+    bodyInteractions = 0;
+    pool.parallelFor(
+        targets,
+        simulation.forceChunkSize,
+        [&](size_t begin, size_t end) {
+            std::vector<BasicVec2<double>> pulls(end - begin, {0., 0.});
+            // Every target of the chunk goes through a tile before the
+            // next one is loaded.
+            for (size_t first = 0; first < n; first += tileSize) {
+                size_t const count = std::min(tileSize, n - first);
+                for (size_t j = begin; j < end; j++) {
+                    Entity const e = active ? (*active)[j] : Entity(j);
+                    RealVec2 const pull = directSum(
+                        bodies.position(e),
+                        bodies.x.data() + first,
+                        bodies.y.data() + first,
+                        bodies.masses.data() + first,
+                        count
+                    );
+                    pulls[j - begin] += vec2Cast<double>(pull);
+                }
+            }
+            for (size_t j = begin; j < end; j++) {
+                Entity const e = active ? (*active)[j] : Entity(j);
+                field[e] = vec2Cast<Real>(pulls[j - begin] * gamma);
+            }
+            bodyInteractions += (end - begin) * n;
+        }
+    );
+}
\ No newline at end of file
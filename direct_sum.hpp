@@ -0,0 +1,50 @@
+#ifndef PARSIM_DIRECT_SUM_H
+#define PARSIM_DIRECT_SUM_H
+
+#include <atomic>
+#include <vector>
+
+#include "gravity_solver.hpp"
+
+// Sums the pull of every body on every other, O(N^2) with no
+// approximation, as the reference the tree solvers' error is measured
+// against. The bodies' columns are split into tiles of `tileSize` sources
+// that stay in cache while a chunk of targets sums them with `directSum`,
+// and the partial sum of each tile is added up in double so the rounding
+// doesn't grow with N. Targets are spread over the pool in chunks of
+// `Simulation::forceChunkSize`.
+//
+// Ignores the tree, though `Simulation` still builds it.
+class DirectSumSolver : public GravitySolver {
+public:
+    // sources per tile, x, y and mass of 1024 floats fit in a 32 KiB L1
+    size_t tileSize;
+
+    explicit DirectSumSolver(size_t _tileSize = 1024);
+    void computeField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    ) override;
+    void computeFieldFor(
+        Simulation const& simulation,
+        std::vector<Entity> const& active,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    ) override;
+    // every pair is a body interaction
+    Interactions interactions() const override;
+
+private:
+    std::atomic<size_t> bodyInteractions{0};
+
+    // every body with a null `active`
+    void sum(
+        Simulation const& simulation,
+        std::vector<Entity> const *active,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    );
+};
+
+#endif /* PARSIM_DIRECT_SUM_H */
\ No newline at end of file
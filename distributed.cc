@@ -0,0 +1,250 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "simulation.hpp"
+#include "barnes_hut.hpp"
+#include "distributed_simulation.hpp"
+#include "snapshot.hpp"
+#include "world.hpp"
+
+// Runs the simulation split over several processes on this machine, see
+// `DistributedSimulation`, and reports the step throughput and how the
+// bodies and the force time ended up spread over the ranks.
+
+namespace {
+struct Options {
+    World::Source source;
+    size_t ranks = 2;
+    size_t steps = 100;
+    float dt = 1.f / 200.f;
+    float theta = 0.5f;
+    size_t substeps = 10;
+    // per rank
+    size_t threads = 1;
+    QuadTree::BuildMode buildMode = QuadTree::BuildMode::morton;
+    size_t leafCapacity = 8;
+    size_t groupSize = 0;
+    size_t rebalanceEvery = 1;
+    // the gathered bodies are written here after the run when set
+    char const *savePath = nullptr;
+};
+
+// what each rank reports back to rank 0 at the end
+struct RankReport {
+    uint64_t bodies;
+    uint64_t maxGhosts;
+    double forceSeconds;
+    double exchangeSeconds;
+    uint64_t bytesSent;
+};
+
+void usage(char const *argv0) {
+    std::cerr
+        <<"usage: "<<argv0<<" [options] [bodies.csv]"<<std::endl
+        <<"  --ranks N                  processes (2)"<<std::endl
+        <<"  --steps N                  updates to run (100)"<<std::endl
+        <<"  --dt SECONDS               time per update (0.005)"<<std::endl
+        <<"  --theta T                  Barnes-Hut opening angle (0.5)"
+        <<std::endl
+        <<"  --substeps N               steps per update (10)"<<std::endl
+        <<"  --threads N                force threads per rank (1)"
+        <<std::endl
+        <<"  --build incremental|morton quad tree construction (morton)"
+        <<std::endl
+        <<"  --leaf-capacity N          bodies per quad tree leaf (8)"
+        <<std::endl
+        <<"  --group-size N             Barnes-Hut group size (0)"
+        <<std::endl
+        <<"  --rebalance-every N        updates between load balancing,"
+        <<std::endl
+        <<"                             0 keeps the first split (1)"
+        <<std::endl
+        <<"  --snapshot PATH            start from a snapshot instead of"
+        <<std::endl
+        <<"                             the csv"<<std::endl
+        <<"  --save PATH                write a snapshot of all ranks'"
+        <<std::endl
+        <<"                             bodies after the run"<<std::endl;
+}
+
+bool parseOptions(int argc, char **argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string const arg = argv[i];
+        bool const hasValue = i + 1 < argc;
+        if (arg == "--ranks" && hasValue) {
+            options.ranks = std::strtoull(argv[++i], nullptr, 10);
+            if (options.ranks == 0) {
+                return false;
+            }
+        } else if (arg == "--steps" && hasValue) {
+            options.steps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--dt" && hasValue) {
+            options.dt = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--theta" && hasValue) {
+            options.theta = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--substeps" && hasValue) {
+            options.substeps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--build" && hasValue) {
+            std::string const mode = argv[++i];
+            if (mode == "incremental") {
+                options.buildMode = QuadTree::BuildMode::incremental;
+            } else if (mode == "morton") {
+                options.buildMode = QuadTree::BuildMode::morton;
+            } else {
+                return false;
+            }
+        } else if (arg == "--leaf-capacity" && hasValue) {
+            options.leafCapacity = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--group-size" && hasValue) {
+            options.groupSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--rebalance-every" && hasValue) {
+            options.rebalanceEvery = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--snapshot" && hasValue) {
+            options.source.snapshotPath = argv[++i];
+        } else if (arg == "--save" && hasValue) {
+            options.savePath = argv[++i];
+        } else if (arg.size() > 0 && arg[0] != '-') {
+            options.source.bodiesPath = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// same world as the windowed build on a 900x700 window
+Simulation makeSimulation(Options const& options) {
+    return World::create(
+        World::defaultScreen,
+        options.theta,
+        options.buildMode
+    );
+}
+
+int runRank(Options const& options, Transport& transport) {
+    bool const root = transport.rank() == 0;
+    Simulation simulation = makeSimulation(options);
+    simulation.setThreadCount(options.threads);
+    simulation.tree.leafCapacity = options.leafCapacity;
+    simulation.substeps = options.substeps;
+    simulation.setSolver(
+        std::make_unique<BarnesHutSolver>(options.groupSize)
+    );
+    // a rank that fails to load still has to take part, or the others
+    // would wait for it forever
+    Transport::Message loaded(1, 1);
+    if (root && !World::load(options.source, simulation)) {
+        loaded[0] = 0;
+    }
+    std::vector<Transport::Message> everyone;
+    if (!transport.allGather(loaded, everyone) || everyone[0][0] == 0) {
+        return 1;
+    }
+
+    DistributedSimulation distributed(transport, simulation);
+    if (!distributed.valid()) {
+        std::cerr<<"rank "<<transport.rank()<<": lost a peer"<<std::endl;
+        return 1;
+    }
+    distributed.rebalanceEvery = options.rebalanceEvery;
+    RankReport report = {0, 0, 0., 0., 0};
+    auto const start = std::chrono::steady_clock::now();
+    for (size_t step = 0; step < options.steps; step++) {
+        if (!distributed.update(options.dt)) {
+            std::cerr<<"rank "<<transport.rank()<<": lost a peer"<<std::endl;
+            return 1;
+        }
+        DistributedSimulation::Stats const& stats = distributed.stats();
+        report.maxGhosts = std::max<uint64_t>(report.maxGhosts, stats.ghosts);
+        report.forceSeconds += stats.forceSeconds;
+        report.exchangeSeconds += stats.exchangeSeconds;
+    }
+    auto const end = std::chrono::steady_clock::now();
+    report.bodies = simulation.size();
+    report.bytesSent = transport.bytesSent();
+
+    Transport::Message mine(sizeof(report));
+    std::memcpy(mine.data(), &report, sizeof(report));
+    std::vector<Transport::Message> reports;
+    if (!transport.allGather(mine, reports)) {
+        return 1;
+    }
+    Simulation gathered = makeSimulation(options);
+    if (!distributed.gather(gathered)) {
+        return 1;
+    }
+    if (!root) {
+        return 0;
+    }
+
+    double const
+        seconds = std::chrono::duration<double>(end - start).count()
+    ,   stepsPerSec = options.steps / seconds
+    ;
+    size_t const steps = std::max<size_t>(options.steps, 1);
+    std::cout
+        <<"bodies: "<<gathered.size()<<std::endl
+        <<"ranks: "<<transport.size()<<std::endl
+        <<"steps: "<<options.steps<<std::endl
+        <<"seconds: "<<seconds<<std::endl
+        <<"steps/sec: "<<stepsPerSec<<std::endl
+        <<"bodies*steps/sec: "<<stepsPerSec * gathered.size()<<std::endl;
+    double maxForce = 0., sumForce = 0.;
+    std::printf(
+        "%5s %10s %10s %16s %19s %12s\n",
+        "rank", "bodies", "ghosts", "force ms/update",
+        "exchange ms/update", "MB sent"
+    );
+    for (size_t r = 0; r < reports.size(); r++) {
+        RankReport other;
+        std::memcpy(&other, reports[r].data(), sizeof(other));
+        maxForce = std::max(maxForce, other.forceSeconds);
+        sumForce += other.forceSeconds;
+        std::printf(
+            "%5zu %10llu %10llu %16.2f %19.2f %12.2f\n",
+            r,
+            (unsigned long long)other.bodies,
+            (unsigned long long)other.maxGhosts,
+            other.forceSeconds * 1e3 / steps,
+            other.exchangeSeconds * 1e3 / steps,
+            other.bytesSent / 1e6
+        );
+    }
+    if (sumForce > 0.) {
+        std::cout
+            <<"force time imbalance (max / mean): "
+            <<maxForce * reports.size() / sumForce<<std::endl;
+    }
+
+    if (options.savePath) {
+        Snapshot::Status const status =
+            Snapshot::write(gathered, options.savePath);
+        if (status != Snapshot::Status::ok) {
+            std::cerr
+                <<options.savePath<<": "<<Snapshot::describe(status)
+                <<std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+    return Transport::spawn(options.ranks, [&](Transport& transport) {
+        return runRank(options, transport);
+    });
+}
\ No newline at end of file
@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "distributed_simulation.hpp"
+
+namespace {
+using Message = Transport::Message;
+using Clock = std::chrono::steady_clock;
+
+// bits per axis of the Morton buckets the curve is cut at
+constexpr unsigned bucketLevels = 8;
+constexpr size_t bucketCount = size_t(1) << (2 * bucketLevels);
+
+template <typename T>
+void put(Message& m, T const& value) {
+    char const *bytes = reinterpret_cast<char const *>(&value);
+    m.insert(m.end(), bytes, bytes + sizeof(T));
+}
+
+// reads back what `put` wrote, in the same order
+class Unpacker {
+public:
+    explicit Unpacker(Message const& _message) : message(_message) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, message.data() + at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+    bool done() const {
+        return at >= message.size();
+    }
+
+private:
+    Message const& message;
+    size_t at = 0;
+};
+
+uint32_t spreadBits(uint32_t v) {
+    v = (v | v << 4) & 0x0f0f;
+    v = (v | v << 2) & 0x3333;
+    v = (v | v << 1) & 0x5555;
+    return v;
+}
+
+uint32_t cellOf(Real value, float origin, float extent) {
+    double const
+        cells = double(1u << bucketLevels)
+    ,   t = std::floor((double(value) - origin) / extent * cells)
+    ;
+    return uint32_t(std::clamp(t, 0., cells - 1.));
+}
+
+uint32_t bucketOf(Real x, Real y, Rect const& bounds) {
+    return spreadBits(cellOf(x, bounds.x, bounds.width))
+        | spreadBits(cellOf(y, bounds.y, bounds.height)) << 1;
+}
+
+// everything about a body that moves with it to another rank
+void putBody(
+    Message& m,
+    Simulation const& simulation,
+    Entity e,
+    uint64_t id,
+    double cost
+) {
+    BodyStore<Real> const& bodies = simulation.bodies;
+    put(m, id);
+    put(m, cost);
+    put(m, bodies.x[e]);
+    put(m, bodies.y[e]);
+    put(m, bodies.vx[e]);
+    put(m, bodies.vy[e]);
+    put(m, bodies.masses[e]);
+    put(m, bodies.radii[e]);
+    put(m, uint64_t(simulation.materials[e]));
+    put(m, simulation.colors[e]);
+}
+
+constexpr size_t bodyBytes =
+    2 * sizeof(uint64_t) + sizeof(double) + 6 * sizeof(Real) + sizeof(Rgba);
+
+// the rest of what `putBody` wrote after the id and cost
+void getBody(Unpacker& u, Simulation& simulation, Entity e) {
+    BodyStore<Real>& bodies = simulation.bodies;
+    bodies.x[e] = u.get<Real>();
+    bodies.y[e] = u.get<Real>();
+    bodies.vx[e] = u.get<Real>();
+    bodies.vy[e] = u.get<Real>();
+    bodies.masses[e] = u.get<Real>();
+    bodies.radii[e] = u.get<Real>();
+    simulation.materials[e] = u.get<uint64_t>();
+    simulation.colors[e] = u.get<Rgba>();
+}
+
+struct Box {
+    Real minX, minY, maxX, maxY;
+
+    bool empty() const {
+        return minX > maxX;
+    }
+};
+
+// What a rank whose bodies are all inside `box` needs of `tree`: the
+// Barnes-Hut group walk, with the accepted nodes as their mass and the
+// opened leaves as their bodies, as x, y, mass.
+void exportTo(
+    QuadTree const& tree,
+    Real theta,
+    Box const& box,
+    Message& out
+) {
+    QuadTree::Index const end = tree.nodeCount();
+    for (QuadTree::Index i = 0; i < end;) {
+        QuadTree::Hot const& node = tree.hot[i];
+        if (node.count == 0) {
+            i = node.next;
+            continue;
+        }
+        Real const
+            centerX = node.massCenter.x
+        ,   centerY = node.massCenter.y
+        ,   distX = std::max<Real>(
+                {box.minX - centerX, centerX - box.maxX, 0}
+            )
+        ,   distY = std::max<Real>(
+                {box.minY - centerY, centerY - box.maxY, 0}
+            )
+        ,   dist = std::sqrt(distX * distX + distY * distY)
+        ;
+        bool const isFar = node.size / dist < theta;
+        if (isFar) {
+            put(out, centerX);
+            put(out, centerY);
+            put(out, node.mass);
+            i = node.next;
+        } else if (tree.isLeaf(i)) {
+            for (auto k = node.first; k < node.first + node.count; k++) {
+                put(out, tree.bodyX[k]);
+                put(out, tree.bodyY[k]);
+                put(out, tree.bodyMasses[k]);
+            }
+            i = node.next;
+        } else {
+            i++;
+        }
+    }
+}
+}
+
+DistributedSimulation::DistributedSimulation(
+    Transport& _transport,
+    Simulation& _simulation
+)
+: transport(_transport)
+, simulation(_simulation) {
+    size_t const n = simulation.size();
+    Message count;
+    put(count, uint64_t(n));
+    std::vector<Message> counts;
+    if (!transport.allGather(count, counts)) {
+        return;
+    }
+    uint64_t first = 0;
+    for (size_t r = 0; r < transport.rank(); r++) {
+        first += Unpacker(counts[r]).get<uint64_t>();
+    }
+    bodyIds.resize(n);
+    for (size_t e = 0; e < n; e++) {
+        bodyIds[e] = first + e;
+    }
+    costs.assign(n, 1.);
+    started = rebalance();
+}
+
+bool DistributedSimulation::valid() const {
+    return started;
+}
+
+std::vector<uint64_t> const& DistributedSimulation::ids() const {
+    return bodyIds;
+}
+
+DistributedSimulation::Stats const& DistributedSimulation::stats() const {
+    return last;
+}
+
+bool DistributedSimulation::update(float dt) {
+    if (
+        rebalanceEvery > 0
+    &&  updates > 0
+    &&  updates % rebalanceEvery == 0
+    &&  !rebalance()
+    ) {
+        return false;
+    }
+    last = {simulation.size(), 0, 0., 0.};
+    interactions.assign(simulation.size(), 0.);
+    simulation.time += dt;
+    if (!computeForces()) {
+        return false;
+    }
+    size_t const steps = std::max(simulation.substeps, size_t(1));
+    float const h = dt / steps;
+    for (size_t i = 0; i < steps; i++) {
+        simulation.kick(h / 2.f);
+        simulation.drift(h);
+        if (!computeForces()) {
+            return false;
+        }
+        simulation.kick(h / 2.f);
+    }
+    size_t const n = simulation.size();
+    double counted = 0.;
+    for (double count : interactions) {
+        counted += count;
+    }
+    costs.resize(n);
+    for (size_t e = 0; e < n; e++) {
+        costs[e] = counted > 0.
+            ? last.forceSeconds * interactions[e] / counted
+            : last.forceSeconds / n;
+    }
+    updates++;
+    return true;
+}
+
+bool DistributedSimulation::rebalance() {
+    size_t const
+        n = simulation.size()
+    ,   ranks = transport.size()
+    ;
+    Rect const& bounds = simulation.tree.bounds();
+    std::vector<uint32_t> buckets(n);
+    std::vector<double> costOf(bucketCount, 0.);
+    for (Entity e = 0; (size_t)e < n; e++) {
+        buckets[e] = bucketOf(
+            simulation.bodies.x[e],
+            simulation.bodies.y[e],
+            bounds
+        );
+        costOf[buckets[e]] += costs[e];
+    }
+    Message histogram;
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        if (costOf[b] > 0.) {
+            put(histogram, b);
+            put(histogram, costOf[b]);
+        }
+    }
+    std::vector<Message> histograms;
+    if (!transport.allGather(histogram, histograms)) {
+        return false;
+    }
+    // summed in rank order, so every rank cuts at the same buckets
+    std::fill(costOf.begin(), costOf.end(), 0.);
+    for (Message const& m : histograms) {
+        for (Unpacker u(m); !u.done();) {
+            uint32_t const b = u.get<uint32_t>();
+            costOf[b] += u.get<double>();
+        }
+    }
+    double total = 0.;
+    for (double cost : costOf) {
+        total += cost;
+    }
+    // a bucket goes to the rank whose share its middle falls in
+    std::vector<uint32_t> owner(bucketCount, 0);
+    double before = 0.;
+    for (size_t b = 0; b < bucketCount; b++) {
+        if (total > 0.) {
+            double const middle = before + costOf[b] / 2.;
+            owner[b] = std::min<size_t>(middle / total * ranks, ranks - 1);
+        }
+        before += costOf[b];
+    }
+
+    std::vector<Message> outgoing(ranks), incoming;
+    for (Entity e = 0; (size_t)e < n; e++) {
+        putBody(
+            outgoing[owner[buckets[e]]],
+            simulation,
+            e,
+            bodyIds[e],
+            costs[e]
+        );
+    }
+    if (!transport.exchange(outgoing, incoming)) {
+        return false;
+    }
+    size_t received = 0;
+    for (Message const& m : incoming) {
+        received += m.size() / bodyBytes;
+    }
+    simulation.resize(received);
+    bodyIds.resize(received);
+    costs.resize(received);
+    Entity e = 0;
+    for (Message const& m : incoming) {
+        for (Unpacker u(m); !u.done(); e++) {
+            bodyIds[e] = u.get<uint64_t>();
+            costs[e] = u.get<double>();
+            getBody(u, simulation, e);
+        }
+    }
+    return true;
+}
+
+bool DistributedSimulation::computeForces() {
+    auto const start = Clock::now();
+    size_t const
+        n = simulation.size()
+    ,   ranks = transport.size()
+    ;
+    BodyStore<Real>& bodies = simulation.bodies;
+    simulation.buildTree();
+
+    Real const inf = std::numeric_limits<Real>::infinity();
+    Box box = {inf, inf, -inf, -inf};
+    for (size_t e = 0; e < n; e++) {
+        box.minX = std::min(box.minX, bodies.x[e]);
+        box.minY = std::min(box.minY, bodies.y[e]);
+        box.maxX = std::max(box.maxX, bodies.x[e]);
+        box.maxY = std::max(box.maxY, bodies.y[e]);
+    }
+    Message mine;
+    put(mine, box);
+    std::vector<Message> boxes;
+    if (!transport.allGather(mine, boxes)) {
+        return false;
+    }
+    std::vector<Message> outgoing(ranks), incoming;
+    for (size_t r = 0; r < ranks; r++) {
+        Box const other = Unpacker(boxes[r]).get<Box>();
+        if (r != transport.rank() && !other.empty()) {
+            exportTo(simulation.tree, simulation.theta, other, outgoing[r]);
+        }
+    }
+    if (!transport.exchange(outgoing, incoming)) {
+        return false;
+    }
+
+    size_t ghosts = 0;
+    for (size_t r = 0; r < ranks; r++) {
+        if (r != transport.rank()) {
+            ghosts += incoming[r].size() / (3 * sizeof(Real));
+        }
+    }
+    simulation.resize(n + ghosts);
+    Entity g = n;
+    for (size_t r = 0; r < ranks; r++) {
+        if (r == transport.rank()) {
+            continue;
+        }
+        for (Unpacker u(incoming[r]); !u.done(); g++) {
+            bodies.x[g] = u.get<Real>();
+            bodies.y[g] = u.get<Real>();
+            bodies.masses[g] = u.get<Real>();
+        }
+    }
+    auto const exchanged = Clock::now();
+
+    own.resize(n);
+    for (size_t e = 0; e < n; e++) {
+        own[e] = e;
+    }
+    simulation.computeForcesFor(own);
+    if (
+        auto const *perBody =
+            simulation.gravitySolver().interactionsPerBody()
+    ) {
+        for (size_t e = 0; e < n; e++) {
+            interactions[e] += (*perBody)[e];
+        }
+    }
+    simulation.resize(n);
+    auto const end = Clock::now();
+
+    last.ghosts = std::max(last.ghosts, ghosts);
+    last.exchangeSeconds +=
+        std::chrono::duration<double>(exchanged - start).count();
+    last.forceSeconds +=
+        std::chrono::duration<double>(end - exchanged).count();
+    return true;
+}
+
+bool DistributedSimulation::gather(Simulation& into) {
+    std::vector<Message> outgoing(transport.size()), incoming;
+    for (Entity e = 0; (size_t)e < simulation.size(); e++) {
+        putBody(outgoing[0], simulation, e, bodyIds[e], costs[e]);
+    }
+    if (!transport.exchange(outgoing, incoming)) {
+        return false;
+    }
+    if (transport.rank() != 0) {
+        return true;
+    }
+    size_t total = 0;
+    for (Message const& m : incoming) {
+        total += m.size() / bodyBytes;
+    }
+    // bodies are never merged here, so the numbers are still 0 to total
+    into.resize(total);
+    for (Message const& m : incoming) {
+        for (Unpacker u(m); !u.done();) {
+            uint64_t const id = u.get<uint64_t>();
+            u.get<double>();
+            if (id >= total) {
+                return false;
+            }
+            getBody(u, into, id);
+        }
+    }
+    into.time = simulation.time;
+    return true;
+}
\ No newline at end of file
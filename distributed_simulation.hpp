@@ -0,0 +1,81 @@
+#ifndef PARSIM_DISTRIBUTED_SIMULATION_H
+#define PARSIM_DISTRIBUTED_SIMULATION_H
+
+#include <cstdint>
+#include <vector>
+
+#include "simulation.hpp"
+#include "transport.hpp"
+
+// Steps a simulation whose bodies are split over the ranks of a
+// `Transport`, each rank's `Simulation` holding the bodies it owns.
+//
+// The bodies are split along a Morton curve over the tree's viewport: the
+// curve is cut into buckets, the bucket costs of all ranks are summed, and
+// every rank gets a run of buckets with an equal share of the cost. A
+// body's cost is its part of its rank's force time over the last update,
+// in proportion to the interactions the solver counted for it, so a rank
+// that was slow gives bodies away and the expensive bodies weigh more.
+// With a solver that doesn't count per body, every body of a rank costs
+// the same.
+//
+// For a force computation every rank builds a tree of its own bodies and
+// walks it once per other rank against the box around that rank's bodies,
+// like a Barnes-Hut group walk. The nodes far enough from the whole box go
+// out as a mass at their center of mass, the bodies of the leaves that
+// aren't go out as they are. Each rank adds what it got as ghost bodies
+// that pull but aren't moved, computes the forces on its own bodies with
+// its solver and drops the ghosts again. Imported nodes carry their
+// monopole only.
+//
+// Always kick-drift-kick with `Simulation::substeps`; the integrator,
+// block timesteps, collisions and `externalForce` aren't used.
+class DistributedSimulation {
+public:
+    struct Stats {
+        // of this rank, over the last update
+        size_t bodies;
+        size_t ghosts;
+        double forceSeconds;
+        double exchangeSeconds;
+    };
+
+    // updates between two rebalances, 0 keeps the first split
+    size_t rebalanceEvery = 1;
+
+    // Collective. Numbers the bodies of every rank, in rank order, and
+    // splits them over the ranks, they may all start on one. Check `valid`
+    // before using it.
+    DistributedSimulation(Transport& _transport, Simulation& _simulation);
+    // false when a rank went away while the bodies were being numbered or
+    // split, the bodies are then in no state to step
+    bool valid() const;
+    // collective, false when a rank went away
+    bool update(float dt);
+    // Collective. Rank 0 gets every rank's bodies in `into`, in the order
+    // they were numbered in, with the per-body columns of `into` replaced.
+    bool gather(Simulation& into);
+    // the number each of this rank's bodies got at the start
+    std::vector<uint64_t> const& ids() const;
+    Stats const& stats() const;
+
+private:
+    Transport& transport;
+    Simulation& simulation;
+    // per own body
+    std::vector<uint64_t> bodyIds;
+    std::vector<double> costs;
+    // summed over the force computations of the current update
+    std::vector<double> interactions;
+    std::vector<Entity> own;
+    size_t updates = 0;
+    bool started = false;
+    Stats last = {0, 0, 0., 0.};
+
+    // hands every body to the rank its Morton bucket belongs to
+    bool rebalance();
+    // fills in the forces on the own bodies, pulled by every rank's
+    bool computeForces();
+};
+
+#endif /* PARSIM_DISTRIBUTED_SIMULATION_H */
\ No newline at end of file
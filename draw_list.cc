@@ -0,0 +1,110 @@
+#include <algorithm>
+
+#include "draw_list.hpp"
+
+namespace {
+bool overlaps(Rect a, Rect b) {
+    return a.x <= b.x + b.width
+        && b.x <= a.x + a.width
+        && a.y <= b.y + b.height
+        && b.y <= a.y + a.height;
+}
+
+void addBody(
+    RenderState const& state,
+    View const& view,
+    LodSettings const& settings,
+    size_t e,
+    DrawList& list
+) {
+    Vec2 const center = view.toScreen(state.positions[e]);
+    float const radius = state.radii[e] * view.scale;
+    Rect const box = {
+        center.x - radius,
+        center.y - radius,
+        2 * radius,
+        2 * radius,
+    };
+    if (!overlaps(box, settings.screen)) {
+        return;
+    }
+    if (radius < settings.minBodyRadius) {
+        list.splats.push_back({
+            center,
+            std::max(2 * radius, 1.f),
+            state.colors[e],
+        });
+    } else {
+        list.disks.push_back({center, radius, state.colors[e]});
+    }
+}
+}
+
+void DrawList::clear() {
+    disks.clear();
+    splats.clear();
+    outlines.clear();
+    visitedNodes = 0;
+}
+
+void selectDrawList(
+    RenderState const& state,
+    View const& view,
+    LodSettings const& settings,
+    DrawList& list
+) {
+    list.clear();
+    if (state.nodes.empty()) {
+        for (size_t e = 0; e < state.positions.size(); e++) {
+            addBody(state, view, settings, e, list);
+        }
+        return;
+    }
+    // The walk goes on below a node whose bodies are already dealt with
+    // only while the overlay still needs the cells below, `bodiesDoneUntil`
+    // is where such a subtree ends.
+    size_t bodiesDoneUntil = 0;
+    for (size_t i = 0; i < state.nodes.size();) {
+        RenderState::Node const& node = state.nodes[i];
+        list.visitedNodes++;
+
+        Rect const cell = view.toScreen(node.bounds);
+        bool const outlined =
+            int(node.depth) <= settings.overlayDepth
+        &&  overlaps(cell, settings.screen);
+        if (outlined) {
+            list.outlines.push_back(cell);
+        }
+
+        bool bodiesDone = i < bodiesDoneUntil;
+        if (!bodiesDone) {
+            Rect const extent = view.toScreen(node.extent);
+            bool const leaf = node.next == i + 1;
+            if (node.count == 0 || !overlaps(extent, settings.screen)) {
+                bodiesDone = true;
+            } else if (
+                std::max(extent.width, extent.height) < settings.minCellSize
+            ) {
+                list.splats.push_back({
+                    view.toScreen(node.centroid),
+                    std::max({extent.width, extent.height, 1.f}),
+                    node.color,
+                });
+                bodiesDone = true;
+            } else if (leaf) {
+                uint32_t const end = node.first + node.count;
+                for (uint32_t k = node.first; k < end; k++) {
+                    addBody(state, view, settings, state.order[k], list);
+                }
+                bodiesDone = true;
+            }
+            if (bodiesDone) {
+                bodiesDoneUntil = std::max<size_t>(bodiesDoneUntil, node.next);
+            }
+        }
+
+        bool const overlayBelow =
+            outlined && int(node.depth) < settings.overlayDepth;
+        i = !bodiesDone || overlayBelow ? i + 1 : node.next;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef PARSIM_DRAW_LIST_H
+#define PARSIM_DRAW_LIST_H
+
+#include <vector>
+
+#include "render_state.hpp"
+
+struct LodSettings {
+    // what's on screen, in pixels
+    Rect screen;
+    // bodies with a smaller radius on screen are drawn as a splat
+    float minBodyRadius = 1.f;
+    // a subtree whose bodies fit in a smaller box on screen is drawn as a
+    // single splat of their mean position and color
+    float minCellSize = 2.f;
+    // nodes down to this depth are outlined, none when negative
+    int overlayDepth = -1;
+};
+
+// What's left to draw after culling, in screen pixels and grouped by kind so
+// each group goes out as one batch.
+struct DrawList {
+    struct Disk {
+        Vec2 center;
+        float radius;
+        Rgba color;
+    };
+    // a body or a whole cell of them too small to see as more than a square
+    // of `size` pixels
+    struct Splat {
+        Vec2 center;
+        float size;
+        Rgba color;
+    };
+
+    std::vector<Disk> disks;
+    std::vector<Splat> splats;
+    std::vector<Rect> outlines;
+    size_t visitedNodes = 0;
+
+    void clear();
+};
+
+// Walks the tree of `state`, if it has one, skipping the subtrees whose
+// bodies are all off screen and collapsing the ones smaller than
+// `minCellSize` into splats. Depends on nothing but its arguments, so it
+// runs without a window. Reuses the capacity of `list`.
+void selectDrawList(
+    RenderState const& state,
+    View const& view,
+    LodSettings const& settings,
+    DrawList& list
+);
+
+// Defined in simulation_draw.cc, which is only linked into the windowed
+// build. Draws the list and the pointer of `view`.
+void draw(DrawList const& list, View const& view);
+
+#endif /* PARSIM_DRAW_LIST_H */
\ No newline at end of file
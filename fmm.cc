@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <array>
+
+#include "fmm.hpp"
+#include "kernels.hpp"
+#include "profile.hpp"
+#include "simulation.hpp"
+
+using Node = QuadTree::Hot;
+using Index = QuadTree::Index;
+
+namespace {
+constexpr size_t maxTerms =
+    (FmmSolver::maxOrder + 1) * (FmmSolver::maxOrder + 2) / 2;
+using Terms = std::array<double, maxTerms>;
+
+// Coefficients of order `n` are stored one after the other, the one at `k`
+// is for the multi-index (n - k, k), i.e. x^(n - k) y^k.
+constexpr size_t term(unsigned n, unsigned k) {
+    return n * (n + 1) / 2 + k;
+}
+
+// x^a y^b / (a! b!) for every a + b <= p
+void scaledPowers(double x, double y, unsigned p, Terms& out) {
+    std::array<double, FmmSolver::maxOrder + 1> px, py;
+    px[0] = py[0] = 1.;
+    for (unsigned i = 1; i <= p; i++) {
+        px[i] = px[i - 1] * x / i;
+        py[i] = py[i - 1] * y / i;
+    }
+    for (unsigned n = 0; n <= p; n++) {
+        for (unsigned k = 0; k <= n; k++) {
+            out[term(n, k)] = px[n - k] * py[k];
+        }
+    }
+}
+
+// The partial derivatives d^(a + b) / dx^a dy^b of 1/r at (x, y) for every
+// a + b <= p, from the recurrence
+//   n r^2 D(b) = -(2n - 1) sum_i b_i x_i D(b - e_i)
+//                - (n - 1) sum_i b_i (b_i - 1) D(b - 2 e_i)
+// where n = |b|.
+void kernelDerivatives(double x, double y, unsigned p, Terms& out) {
+    double const r2 = x * x + y * y;
+    out[0] = 1. / std::sqrt(r2);
+    for (unsigned n = 1; n <= p; n++) {
+        for (unsigned k = 0; k <= n; k++) {
+            double const
+                bx = n - k
+            ,   by = k
+            ;
+            double first = 0., second = 0.;
+            if (bx >= 1) {
+                first += bx * x * out[term(n - 1, k)];
+            }
+            if (by >= 1) {
+                first += by * y * out[term(n - 1, k - 1)];
+            }
+            if (bx >= 2) {
+                second += bx * (bx - 1) * out[term(n - 2, k)];
+            }
+            if (by >= 2) {
+                second += by * (by - 1) * out[term(n - 2, k - 2)];
+            }
+            out[term(n, k)] =
+                -((2. * n - 1.) * first + (n - 1.) * second) / (n * r2);
+        }
+    }
+}
+}
+
+FmmSolver::FmmSolver(unsigned _order)
+: p(std::clamp(_order, 1u, maxOrder))
+, terms(term(p + 1, 0)) {}
+
+unsigned FmmSolver::order() const {
+    return p;
+}
+
+GravitySolver::Interactions FmmSolver::interactions() const {
+    return {cellInteractions, bodyInteractions, nodeVisits};
+}
+
+void FmmSolver::computeField(
+    Simulation const& simulation,
+    std::vector<RealVec2>& field,
+    ThreadPool& pool
+) {
+    QuadTree const& tree = simulation.tree;
+    size_t const n = tree.bodies.size();
+    fieldX.resize(n);
+    fieldY.resize(n);
+    upwardPass(tree);
+    findTargets(tree, std::max<size_t>(n / (pool.size() * 16), 1));
+    cellInteractions = 0;
+    bodyInteractions = 0;
+    nodeVisits = 0;
+    pool.parallelFor(targets.size(), 1, [&](size_t begin, size_t end) {
+        Interactions counts = {0, 0, 0};
+        for (size_t t = begin; t < end; t++) {
+            interact(tree, simulation.theta, targets[t], counts);
+            downwardPass(tree, targets[t]);
+        }
+        cellInteractions += counts.cells;
+        bodyInteractions += counts.bodies;
+        PARSIM_COUNT(nodeVisits += counts.visits);
+    });
+    for (size_t k = 0; k < n; k++) {
+        field[tree.bodies[k]] = RealVec2 {
+            Real(fieldX[k] * simulation.gamma),
+            Real(fieldY[k] * simulation.gamma),
+        };
+    }
+}
+
+void FmmSolver::upwardPass(QuadTree const& tree) {
+    size_t const count = tree.nodeCount();
+    multipoles.assign(count * terms, 0.);
+    locals.resize(count * terms);
+    centerX.resize(count);
+    centerY.resize(count);
+    extents.resize(count);
+
+    Terms powers;
+    // children come after their parent, see `computeNodeMasses`
+    for (size_t i = count; i-- > 0;) {
+        Node const& node = tree.hot[i];
+        double const
+            cx = centerX[i] = node.massCenter.x
+        ,   cy = centerY[i] = node.massCenter.y
+        ;
+        double *m = &multipoles[i * terms];
+        double extent = 0.;
+        if (tree.isLeaf(i)) {
+            for (auto k = node.first; k < node.first + node.count; k++) {
+                double const
+                    dx = tree.bodyX[k] - cx
+                ,   dy = tree.bodyY[k] - cy
+                ;
+                scaledPowers(dx, dy, p, powers);
+                for (size_t t = 0; t < terms; t++) {
+                    m[t] += tree.bodyMasses[k] * powers[t];
+                }
+                extent = std::max(extent, std::sqrt(dx * dx + dy * dy));
+            }
+            extents[i] = extent;
+            continue;
+        }
+        for (size_t const c : tree.children(i)) {
+            // an empty child has no center to translate from, a refit can
+            // leave one behind
+            if (tree.hot[c].count == 0) {
+                continue;
+            }
+            double const
+                dx = centerX[c] - cx
+            ,   dy = centerY[c] - cy
+            ;
+            double const *mc = &multipoles[c * terms];
+            scaledPowers(dx, dy, p, powers);
+            for (unsigned an = 0; an <= p; an++) {
+                for (unsigned ak = 0; ak <= an; ak++) {
+                    double sum = 0.;
+                    for (unsigned bn = 0; bn <= an; bn++) {
+                        unsigned const
+                            low = ak + bn > an ? ak + bn - an : 0
+                        ,   high = std::min(ak, bn)
+                        ;
+                        for (unsigned bk = low; bk <= high; bk++) {
+                            sum += mc[term(bn, bk)]
+                                * powers[term(an - bn, ak - bk)];
+                        }
+                    }
+                    m[term(an, ak)] += sum;
+                }
+            }
+            extent = std::max(
+                extent,
+                std::sqrt(dx * dx + dy * dy) + extents[c]
+            );
+        }
+        extents[i] = extent;
+    }
+}
+
+void FmmSolver::findTargets(QuadTree const& tree, size_t grain) {
+    targets.clear();
+    Index const end = tree.nodeCount();
+    for (Index i = 0; i < end;) {
+        Node const& node = tree.hot[i];
+        if ((size_t)node.count <= grain || tree.isLeaf(i)) {
+            targets.push_back(i);
+            i = node.next;
+        } else {
+            i++;
+        }
+    }
+}
+
+void FmmSolver::interact(
+    QuadTree const& tree,
+    float theta,
+    Index target,
+    Interactions& counts
+) {
+    Node const& targetNode = tree.hot[target];
+    std::fill(
+        locals.begin() + target * terms,
+        locals.begin() + targetNode.next * terms,
+        0.
+    );
+    std::fill(
+        fieldX.begin() + targetNode.first,
+        fieldX.begin() + targetNode.first + targetNode.count,
+        0.
+    );
+    std::fill(
+        fieldY.begin() + targetNode.first,
+        fieldY.begin() + targetNode.first + targetNode.count,
+        0.
+    );
+
+    Terms derivatives;
+    //                     [ target, source ]
+    std::vector<std::pair<Index, Index>> pairs = {{target, 0}};
+    while (!pairs.empty()) {
+        auto const [a, b] = pairs.back();
+        pairs.pop_back();
+        PARSIM_COUNT(counts.visits++);
+        Node const
+            &nodeA = tree.hot[a]
+        ,   &nodeB = tree.hot[b]
+        ;
+        if (nodeA.count == 0 || nodeB.count == 0) {
+            continue;
+        }
+        double const
+            rx = centerX[a] - centerX[b]
+        ,   ry = centerY[a] - centerY[b]
+        ,   dist = std::sqrt(rx * rx + ry * ry)
+        ;
+        if (extents[a] + extents[b] < theta * dist) {
+            // multipole of b to local of a
+            counts.cells++;
+            kernelDerivatives(rx, ry, p, derivatives);
+            double const *mb = &multipoles[b * terms];
+            double *la = &locals[a * terms];
+            for (unsigned an = 0; an <= p; an++) {
+                for (unsigned ak = 0; ak <= an; ak++) {
+                    double sum = 0.;
+                    for (unsigned bn = 0; an + bn <= p; bn++) {
+                        double const sign = bn % 2 ? -1. : 1.;
+                        for (unsigned bk = 0; bk <= bn; bk++) {
+                            sum += sign * mb[term(bn, bk)]
+                                * derivatives[term(an + bn, ak + bk)];
+                        }
+                    }
+                    la[term(an, ak)] += sum;
+                }
+            }
+            continue;
+        }
+        bool const
+            leafA = nodeA.next == a + 1
+        ,   leafB = nodeB.next == b + 1
+        ;
+        if (leafA && leafB) {
+            for (auto k = nodeA.first; k < nodeA.first + nodeA.count; k++) {
+                RealVec2 const pull = directSum(
+                    RealVec2 {tree.bodyX[k], tree.bodyY[k]},
+                    tree.bodyX.data() + nodeB.first,
+                    tree.bodyY.data() + nodeB.first,
+                    tree.bodyMasses.data() + nodeB.first,
+                    nodeB.count
+                );
+                fieldX[k] += pull.x;
+                fieldY[k] += pull.y;
+            }
+            counts.bodies += size_t(nodeA.count) * nodeB.count;
+            continue;
+        }
+        if (leafB || (!leafA && extents[a] >= extents[b])) {
+            for (Index const c : tree.children(a)) {
+                pairs.push_back({c, b});
+            }
+        } else {
+            for (Index const c : tree.children(b)) {
+                pairs.push_back({a, c});
+            }
+        }
+    }
+}
+
+void FmmSolver::downwardPass(QuadTree const& tree, Index target) {
+    Terms powers;
+    // parents come before their children, so a node's local expansion is
+    // complete by the time it's pushed down
+    for (Index i = target; i < tree.hot[target].next; i++) {
+        Node const& node = tree.hot[i];
+        double const *l = &locals[i * terms];
+        if (!tree.isLeaf(i)) {
+            for (size_t const c : tree.children(i)) {
+                if (tree.hot[c].count == 0) {
+                    continue;
+                }
+                double *lc = &locals[c * terms];
+                scaledPowers(
+                    centerX[c] - centerX[i],
+                    centerY[c] - centerY[i],
+                    p,
+                    powers
+                );
+                for (unsigned an = 0; an <= p; an++) {
+                    for (unsigned ak = 0; ak <= an; ak++) {
+                        double sum = 0.;
+                        for (unsigned bn = an; bn <= p; bn++) {
+                            for (unsigned bk = ak; bk <= bn - an + ak; bk++) {
+                                sum += l[term(bn, bk)]
+                                    * powers[term(bn - an, bk - ak)];
+                            }
+                        }
+                        lc[term(an, ak)] += sum;
+                    }
+                }
+            }
+            continue;
+        }
+        // the field is the gradient of the local expansion
+        for (auto k = node.first; k < node.first + node.count; k++) {
+            scaledPowers(
+                tree.bodyX[k] - centerX[i],
+                tree.bodyY[k] - centerY[i],
+                p,
+                powers
+            );
+            double gx = 0., gy = 0.;
+            for (unsigned an = 1; an <= p; an++) {
+                for (unsigned ak = 0; ak <= an; ak++) {
+                    if (ak < an) {
+                        gx += l[term(an, ak)] * powers[term(an - 1, ak)];
+                    }
+                    if (ak > 0) {
+                        gy += l[term(an, ak)] * powers[term(an - 1, ak - 1)];
+                    }
+                }
+            }
+            fieldX[k] += gx;
+            fieldY[k] += gy;
+        }
+    }
+}
\ No newline at end of file
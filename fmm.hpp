@@ -0,0 +1,73 @@
+#ifndef PARSIM_FMM_H
+#define PARSIM_FMM_H
+
+#include <atomic>
+#include <vector>
+
+#include "gravity_solver.hpp"
+#include "quad_tree.hpp"
+
+// Fast multipole method on the simulation's quad tree.
+//
+// The force between bodies falls off with the square of the distance, so the
+// potential is 1/r even though the bodies live in a plane. That potential
+// isn't harmonic in 2D, so the complex-number expansions of the classic 2D
+// FMM don't apply. Instead the expansions are Cartesian Taylor series in
+// (x, y) up to `order`. Every node gets a multipole expansion about its
+// center of mass. A dual tree walk turns pairs of nodes that are well
+// separated, `(extentA + extentB) / distance < Simulation::theta`, into
+// local expansions, and sums pairs of leaves that aren't directly. The local
+// expansions are then pushed down to the bodies.
+//
+// The walk starts from a set of disjoint subtrees so that each can be handed
+// to a different thread without locking.
+class FmmSolver : public GravitySolver {
+public:
+    static constexpr unsigned maxOrder = 12;
+
+    // clamped to [1, maxOrder]
+    explicit FmmSolver(unsigned _order = 4);
+    void computeField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    ) override;
+    unsigned order() const;
+    // cells are the multipole to local translations, bodies the pairs of
+    // bodies in leaves summed directly and visits the pairs of nodes looked
+    // at
+    Interactions interactions() const override;
+
+private:
+    unsigned p;
+    // expansion coefficients per node, (p + 1)(p + 2) / 2 of them
+    size_t terms;
+
+    // per node, in the same order as `QuadTree::hot`
+    std::vector<double> multipoles;
+    std::vector<double> locals;
+    std::vector<double> centerX;
+    std::vector<double> centerY;
+    // distance from the center to the farthest body of the node
+    std::vector<double> extents;
+    // per body, in the same order as `QuadTree::bodies`
+    std::vector<double> fieldX;
+    std::vector<double> fieldY;
+    // the subtrees the work is split into
+    std::vector<QuadTree::Index> targets;
+    std::atomic<size_t> cellInteractions{0};
+    std::atomic<size_t> bodyInteractions{0};
+    std::atomic<size_t> nodeVisits{0};
+
+    void upwardPass(QuadTree const& tree);
+    void findTargets(QuadTree const& tree, size_t grain);
+    void interact(
+        QuadTree const& tree,
+        float theta,
+        QuadTree::Index target,
+        Interactions& counts
+    );
+    void downwardPass(QuadTree const& tree, QuadTree::Index target);
+};
+
+#endif /* PARSIM_FMM_H */
\ No newline at end of file
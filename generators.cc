@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "generators.hpp"
+#include "simulation.hpp"
+
+namespace {
+// SplitMix64, small and good enough for initial conditions
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = state += 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+    // [0, 1)
+    double uniform() {
+        return (next() >> 11) * 0x1p-53;
+    }
+    // (0, 1]
+    double uniformOpen() {
+        return 1. - uniform();
+    }
+
+private:
+    uint64_t state;
+};
+
+struct Body {
+    double x, y, vx, vy;
+};
+
+// x and y of a direction picked uniformly in space
+std::pair<double, double> projectedDirection(Random& random) {
+    double const
+        z = 2. * random.uniform() - 1.
+    ,   phi = 2. * M_PI * random.uniform()
+    ,   s = std::sqrt(1. - z * z)
+    ;
+    return {s * std::cos(phi), s * std::sin(phi)};
+}
+
+// A body of a Plummer sphere in units where G, its mass and its scale
+// length are 1, no farther out than `cutoff`. The speed is drawn from the
+// distribution function by rejection, as in Aarseth, Henon & Wielen (1974).
+Body plummerBody(Random& random, double cutoff) {
+    double r;
+    do {
+        r = 1. / std::sqrt(std::pow(random.uniformOpen(), -2. / 3.) - 1.);
+    } while (!(r <= cutoff));
+    double q, g;
+    do {
+        q = random.uniform();
+        g = 0.1 * random.uniform();
+    } while (g > q * q * std::pow(1. - q * q, 3.5));
+    double const speed = q * std::sqrt(2.) * std::pow(1. + r * r, -0.25);
+    auto const [px, py] = projectedDirection(random);
+    auto const [wx, wy] = projectedDirection(random);
+    return {r * px, r * py, speed * wx, speed * wy};
+}
+
+// uniform over a disk of `radius` around the origin
+std::pair<double, double> diskPoint(Random& random, double radius) {
+    double const
+        r = radius * std::sqrt(random.uniform())
+    ,   phi = 2. * M_PI * random.uniform()
+    ;
+    return {r * std::cos(phi), r * std::sin(phi)};
+}
+
+// takes out the drift of bodies [first, last) left by sampling, they all
+// weigh the same
+void removeDrift(Simulation& simulation, size_t first, size_t last) {
+    if (first == last) {
+        return;
+    }
+    double vx = 0., vy = 0.;
+    for (size_t e = first; e < last; e++) {
+        vx += simulation.bodies.vx[e];
+        vy += simulation.bodies.vy[e];
+    }
+    vx /= double(last - first);
+    vy /= double(last - first);
+    for (size_t e = first; e < last; e++) {
+        simulation.bodies.vx[e] -= Real(vx);
+        simulation.bodies.vy[e] -= Real(vy);
+    }
+}
+
+Rgba const clusterColors[] = {
+    palette::skyblue,
+    palette::orange,
+    palette::lime,
+    palette::pink,
+    palette::gold,
+    palette::violet,
+    palette::red,
+    palette::blue,
+};
+}
+
+void Generator::addTo(Simulation& simulation) const {
+    Random random(seed);
+    Real const mass = simulation.massOf(bodyRadius, material);
+    double const
+        gamma = simulation.gamma
+    ,   totalMass = double(mass) * count
+    ;
+    size_t first = simulation.size();
+    bool const central = layout == Layout::exponentialDisk;
+    simulation.resize(first + count + central);
+    auto const place = [&](Entity e, Body const& b, Rgba c) {
+        simulation.bodies.setPosition(e, {
+            Real(center.x + b.x),
+            Real(center.y + b.y),
+        });
+        simulation.bodies.setVelocity(e, {Real(b.vx), Real(b.vy)});
+        simulation.bodies.masses[e] = mass;
+        simulation.bodies.radii[e] = bodyRadius;
+        simulation.materials[e] = material;
+        simulation.colors[e] = c;
+    };
+
+    switch (layout) {
+    case Layout::uniformDisk:
+        for (size_t k = 0; k < count; k++) {
+            auto const [x, y] = diskPoint(random, radius);
+            place(first + k, {x, y, 0., 0.}, color);
+        }
+        break;
+    case Layout::plummer: {
+        double const
+            a = radius / 4.
+        ,   speedScale = std::sqrt(gamma * totalMass / a)
+        ;
+        for (size_t k = 0; k < count; k++) {
+            Body const b = plummerBody(random, radius / a);
+            place(
+                first + k,
+                {b.x * a, b.y * a, b.vx * speedScale, b.vy * speedScale},
+                color
+            );
+        }
+        removeDrift(simulation, first, first + count);
+        break;
+    }
+    case Layout::exponentialDisk: {
+        // The central body is of the densest material, to keep it small,
+        // and no wider than h / 4 so the disk always has room outside it.
+        auto const densest = std::max_element(
+            simulation.materialsTable.begin(),
+            simulation.materialsTable.end(),
+            [](MaterialInfo const& a, MaterialInfo const& b) {
+                return a.density < b.density;
+            }
+        );
+        double const
+            centerMass = centralMass * totalMass
+        ,   density = densest->density
+        ,   h = radius / 4.
+        ,   centerRadius = std::min(
+                std::sqrt(centerMass / (M_PI * density)),
+                h / 4.
+            )
+        ;
+        place(first, {0., 0., 0., 0.}, palette::gold);
+        simulation.bodies.masses[first] = Real(centerMass);
+        simulation.bodies.radii[first] = Real(centerRadius);
+        simulation.materials[first] =
+            densest - simulation.materialsTable.begin();
+        first++;
+        for (size_t k = 0; k < count; k++) {
+            // r e^(-r/h) is a gamma distribution of shape 2, the sum of two
+            // exponential ones
+            double r;
+            do {
+                r = -h * std::log(random.uniformOpen() * random.uniformOpen());
+            } while (r > radius || r < 2. * centerRadius);
+            double const
+                phi = 2. * M_PI * random.uniform()
+            ,   inside = totalMass * (1. - (1. + r / h) * std::exp(-r / h))
+            ,   speed = std::sqrt(gamma * (centerMass + inside) / r)
+            ,   c = std::cos(phi)
+            ,   s = std::sin(phi)
+            ;
+            place(first + k, {r * c, r * s, -speed * s, speed * c}, color);
+        }
+        break;
+    }
+    case Layout::clusters: {
+        size_t const k = std::max<size_t>(clusters, 1);
+        double const
+            a = 0.2 * radius / std::sqrt(double(k))
+        ,   cutoff = 5.
+        ,   spread = std::max(radius - cutoff * a, 0.)
+        ;
+        size_t body = 0;
+        for (size_t c = 0; c < k; c++) {
+            // the first `count % k` clusters get a body more
+            size_t const members = count / k + (c < count % k);
+            auto const [cx, cy] = diskPoint(random, spread);
+            double const speedScale =
+                std::sqrt(gamma * double(mass) * members / a);
+            Rgba const tint = clusterColors[c % std::size(clusterColors)];
+            for (size_t m = 0; m < members; m++, body++) {
+                Body const b = plummerBody(random, cutoff);
+                place(
+                    first + body,
+                    {
+                        cx + b.x * a,
+                        cy + b.y * a,
+                        b.vx * speedScale,
+                        b.vy * speedScale,
+                    },
+                    tint
+                );
+            }
+            removeDrift(simulation, first + body - members, first + body);
+        }
+        break;
+    }
+    }
+}
+
+bool Generator::parseLayout(std::string const& name, Layout& layout) {
+    for (Layout l : {
+        Layout::uniformDisk,
+        Layout::plummer,
+        Layout::exponentialDisk,
+        Layout::clusters,
+    }) {
+        if (name == layoutName(l)) {
+            layout = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+char const *Generator::layoutName(Layout layout) {
+    switch (layout) {
+    case Layout::uniformDisk:
+        return "uniform-disk";
+    case Layout::plummer:
+        return "plummer";
+    case Layout::exponentialDisk:
+        return "exponential-disk";
+    case Layout::clusters:
+        return "clusters";
+    }
+    return "?";
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef PARSIM_GENERATORS_H
+#define PARSIM_GENERATORS_H
+
+#include <cstdint>
+#include <string>
+
+#include "common.hpp"
+
+class Simulation;
+
+// Synthetic initial conditions of any size, added to a simulation's columns
+// directly. The same seed gives the same bodies on every platform: the
+// random numbers come from SplitMix64 and are turned into distributions
+// here rather than by the standard library, whose distributions differ
+// between implementations.
+//
+// Velocities use `Simulation::gamma` and the bodies' masses, which come
+// from `bodyRadius` and `material` like with `Simulation::add`.
+struct Generator {
+    enum class Layout {
+        // uniform over a disk of `radius`, at rest, so it collapses
+        uniformDisk,
+        // a Plummer sphere with scale length `radius / 4`, positions and
+        // velocities (from its distribution function) projected onto the
+        // plane, which leaves it short of equilibrium there, so it
+        // contracts a little at first
+        plummer,
+        // surface density falling off as exp(-r / h) with h = `radius / 4`,
+        // on circular orbits around a central body of `centralMass` times
+        // the disk's mass
+        exponentialDisk,
+        // `clusters` Plummer spheres spread uniformly over a disk of
+        // `radius`, each at rest as a whole
+        clusters,
+    };
+
+    Layout layout = Layout::uniformDisk;
+    size_t count = 1000;
+    uint64_t seed = 1;
+    RealVec2 center = {0, 0};
+    // every body lies within it, tails are cut off, must be positive
+    Real radius = 1000;
+    Real bodyRadius = 1;
+    size_t material = 0;
+    Rgba color = palette::skyblue;
+    // times the disk's mass. The central body's radius follows from it and
+    // the densest material, but is capped at `radius / 16`, so a heavy
+    // disk gets a central body denser than any material.
+    Real centralMass = 1;
+    size_t clusters = 8;
+
+    // Appends `count` bodies, plus the central body of an exponential
+    // disk, which comes first.
+    void addTo(Simulation& simulation) const;
+
+    // "uniform-disk", "plummer", "exponential-disk" or "clusters"
+    static bool parseLayout(std::string const& name, Layout& layout);
+    static char const *layoutName(Layout layout);
+};
+
+#endif /* PARSIM_GENERATORS_H */
\ No newline at end of file
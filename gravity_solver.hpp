@@ -0,0 +1,88 @@
+#ifndef PARSIM_GRAVITY_SOLVER_H
+#define PARSIM_GRAVITY_SOLVER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "common.hpp"
+#include "thread_pool.hpp"
+
+class Simulation;
+
+// Computes the gravitational field, the force per unit of mass, at every
+// body. `Simulation::update` calls it after the quad tree has been built and
+// its mass moments computed, so a solver can use `simulation.tree` as is.
+class GravitySolver {
+public:
+    // the work done by the tree walks of a call
+    struct Interactions {
+        // nodes accepted as a whole
+        size_t cells;
+        // bodies summed directly
+        size_t bodies;
+        // nodes looked at, only counted with `PARSIM_PROFILE`
+        size_t visits;
+    };
+
+    virtual ~GravitySolver() = default;
+    // `field` has a slot for every body, indexed by entity
+    virtual void computeField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    ) = 0;
+    // Like `computeField`, but only the bodies in `active` need their field
+    // filled in. Solvers that can't do less work for a subset compute all
+    // of them.
+    virtual void computeFieldFor(
+        Simulation const& simulation,
+        std::vector<Entity> const& /* active */,
+        std::vector<RealVec2>& field,
+        ThreadPool& pool
+    ) {
+        computeField(simulation, field, pool);
+    }
+
+    // For multiple time stepping the field is split in two: a far part that
+    // changes slowly and a near part that is refreshed more often.
+    // `computeSplitField` computes both, and `computeNearField` redoes just
+    // the near part for the bodies' current positions. Unless a solver says
+    // otherwise, all of the field is near.
+    virtual void computeSplitField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& far,
+        std::vector<RealVec2>& near,
+        ThreadPool& pool
+    ) {
+        std::fill(far.begin(), far.end(), RealVec2 {0, 0});
+        computeField(simulation, near, pool);
+    }
+    virtual void computeNearField(
+        Simulation const& simulation,
+        std::vector<RealVec2>& near,
+        ThreadPool& pool
+    ) {
+        computeField(simulation, near, pool);
+    }
+    // Whether `computeNearField` needs the tree rebuilt for the current
+    // positions first. Solvers that remember the near bodies from the last
+    // `computeSplitField` don't.
+    virtual bool nearFieldNeedsTree() const {
+        return true;
+    }
+    // Summed over all bodies by the last call that computed a field.
+    // Solvers that don't count report zero.
+    virtual Interactions interactions() const {
+        return {0, 0, 0};
+    }
+    // Cells and bodies each body interacted with in the last `computeField`
+    // or `computeFieldFor`, by entity, for weighing the work per body. Null
+    // for solvers that don't count per body, only the bodies whose field
+    // was computed are filled in.
+    virtual std::vector<uint32_t> const *interactionsPerBody() const {
+        return nullptr;
+    }
+};
+
+#endif /* PARSIM_GRAVITY_SOLVER_H */
\ No newline at end of file
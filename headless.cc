@@ -0,0 +1,370 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "simulation.hpp"
+#include "barnes_hut.hpp"
+#include "direct_sum.hpp"
+#include "fmm.hpp"
+#include "snapshot.hpp"
+#include "trajectory.hpp"
+#include "world.hpp"
+
+// Runs the simulation without a window as fast as it can and reports the
+// step throughput.
+
+namespace {
+struct Options {
+    World::Source source;
+    size_t steps = 600;
+    float dt = 1.f / 200.f;
+    size_t threads = ThreadPool::defaultThreadCount();
+    QuadTree::BuildMode buildMode = QuadTree::BuildMode::incremental;
+    size_t leafCapacity = 1;
+    std::string solver = "barnes-hut";
+    unsigned fmmOrder = 4;
+    size_t groupSize = 0;
+    bool refitTree = false;
+    // 0 keeps the fixed substeps
+    unsigned blockLevels = 0;
+    std::string integrator = "leapfrog";
+    size_t substeps = 10;
+    size_t respaInnerSteps = 4;
+    Simulation::Collisions collisions = Simulation::Collisions::ignore;
+    // written after the run when set
+    char const *savePath = nullptr;
+    // trajectories are recorded when set
+    char const *recordPath = nullptr;
+    size_t recordEvery = 1;
+    size_t recordBuffers = 4;
+    bool recordDrop = false;
+    // phase timings and tree counters are written here after the run when
+    // set, a row per update when it ends in .csv and totals as JSON
+    // otherwise
+    char const *statsPath = nullptr;
+};
+
+bool endsWith(std::string const& s, std::string const& suffix) {
+    return s.size() >= suffix.size()
+        && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void usage(char const *argv0) {
+    std::cerr
+        <<"usage: "<<argv0<<" [options] [bodies.csv]"<<std::endl
+        <<"  --steps N                  updates to run (600)"<<std::endl
+        <<"  --dt SECONDS               time per update (0.005)"<<std::endl
+        <<"  --threads N                force phase threads (all cores)"
+        <<std::endl
+        <<"  --build incremental|morton quad tree construction"<<std::endl
+        <<"  --leaf-capacity N          bodies per quad tree leaf (1)"
+        <<std::endl
+        <<"  --solver barnes-hut|fmm|direct"<<std::endl
+        <<"                             gravity solver (barnes-hut)"
+        <<std::endl
+        <<"  --fmm-order N              FMM expansion order (4)"<<std::endl
+        <<"  --group-size N             Barnes-Hut walks per group of up to"
+        <<std::endl
+        <<"                             N bodies instead of per body (0)"
+        <<std::endl
+        <<"  --refit                    keep the tree between substeps"
+        <<std::endl
+        <<"  --block-levels N           per body timesteps down to dt / 2^N"
+        <<std::endl
+        <<"                             instead of fixed substeps (0)"
+        <<std::endl
+        <<"  --integrator euler|leapfrog|yoshida|respa"<<std::endl
+        <<"                             substep scheme (leapfrog)"<<std::endl
+        <<"  --respa-inner K            near field steps per far field"
+        <<std::endl
+        <<"                             refresh with respa (4)"<<std::endl
+        <<"  --collisions ignore|bounce|merge"<<std::endl
+        <<"                             what overlapping bodies do (ignore)"
+        <<std::endl
+        <<"  --substeps N               integrator steps per update (10)"
+        <<std::endl
+        <<"  --snapshot PATH            start from a snapshot instead of"
+        <<std::endl
+        <<"                             the csv"<<std::endl
+        <<"  --generate uniform-disk|plummer|exponential-disk|clusters"
+        <<std::endl
+        <<"                             generate the bodies instead of"
+        <<std::endl
+        <<"                             loading the csv"<<std::endl
+        <<"  --count N                  generated bodies (1000)"<<std::endl
+        <<"  --seed N                   generator seed (1)"<<std::endl
+        <<"  --save PATH                write a snapshot after the run"
+        <<std::endl
+        <<"  --record PATH              record trajectories to PATH"
+        <<std::endl
+        <<"  --record-every N           every N updates (1)"<<std::endl
+        <<"  --record-buffers N         frames waiting for the disk (4)"
+        <<std::endl
+        <<"  --record-drop              drop frames instead of waiting when"
+        <<std::endl
+        <<"                             the buffers are full"<<std::endl
+        <<"  --stats PATH               write phase timings and tree"
+        <<std::endl
+        <<"                             counters, per update to a .csv or"
+        <<std::endl
+        <<"                             in total as JSON"<<std::endl;
+}
+
+bool parseOptions(int argc, char **argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string const arg = argv[i];
+        bool const hasValue = i + 1 < argc;
+        if (arg == "--steps" && hasValue) {
+            options.steps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--dt" && hasValue) {
+            options.dt = std::strtof(argv[++i], nullptr);
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--build" && hasValue) {
+            std::string const mode = argv[++i];
+            if (mode == "incremental") {
+                options.buildMode = QuadTree::BuildMode::incremental;
+            } else if (mode == "morton") {
+                options.buildMode = QuadTree::BuildMode::morton;
+            } else {
+                return false;
+            }
+        } else if (arg == "--leaf-capacity" && hasValue) {
+            options.leafCapacity = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--solver" && hasValue) {
+            options.solver = argv[++i];
+            if (
+                options.solver != "barnes-hut"
+            &&  options.solver != "fmm"
+            &&  options.solver != "direct"
+            ) {
+                return false;
+            }
+        } else if (arg == "--fmm-order" && hasValue) {
+            options.fmmOrder = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--group-size" && hasValue) {
+            options.groupSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--collisions" && hasValue) {
+            std::string const mode = argv[++i];
+            if (mode == "ignore") {
+                options.collisions = Simulation::Collisions::ignore;
+            } else if (mode == "bounce") {
+                options.collisions = Simulation::Collisions::bounce;
+            } else if (mode == "merge") {
+                options.collisions = Simulation::Collisions::merge;
+            } else {
+                return false;
+            }
+        } else if (arg == "--refit") {
+            options.refitTree = true;
+        } else if (arg == "--block-levels" && hasValue) {
+            options.blockLevels = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--integrator" && hasValue) {
+            options.integrator = argv[++i];
+            if (
+                options.integrator != "euler"
+            &&  options.integrator != "leapfrog"
+            &&  options.integrator != "yoshida"
+            &&  options.integrator != "respa"
+            ) {
+                return false;
+            }
+        } else if (arg == "--substeps" && hasValue) {
+            options.substeps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--respa-inner" && hasValue) {
+            options.respaInnerSteps = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--snapshot" && hasValue) {
+            options.source.snapshotPath = argv[++i];
+        } else if (arg == "--generate" && hasValue) {
+            options.source.generate = true;
+            if (!Generator::parseLayout(
+                argv[++i],
+                options.source.generator.layout
+            )) {
+                return false;
+            }
+        } else if (arg == "--count" && hasValue) {
+            options.source.generator.count =
+                std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            options.source.generator.seed =
+                std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--save" && hasValue) {
+            options.savePath = argv[++i];
+        } else if (arg == "--record" && hasValue) {
+            options.recordPath = argv[++i];
+        } else if (arg == "--record-every" && hasValue) {
+            options.recordEvery = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--record-buffers" && hasValue) {
+            options.recordBuffers = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--record-drop") {
+            options.recordDrop = true;
+        } else if (arg == "--stats" && hasValue) {
+            options.statsPath = argv[++i];
+        } else if (arg.size() > 0 && arg[0] != '-') {
+            options.source.bodiesPath = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // same world as the windowed build on a 900x700 window
+    Simulation simulation =
+        World::create(World::defaultScreen, 0.5f, options.buildMode);
+    simulation.setThreadCount(options.threads);
+    simulation.tree.leafCapacity = options.leafCapacity;
+    simulation.refitTree = options.refitTree;
+    simulation.blockTimesteps = options.blockLevels > 0;
+    simulation.maxTimestepLevel = options.blockLevels;
+    simulation.substeps = options.substeps;
+    simulation.collisions = options.collisions;
+    if (options.integrator == "euler") {
+        simulation.setIntegrator(std::make_unique<EulerIntegrator>());
+    } else if (options.integrator == "yoshida") {
+        simulation.setIntegrator(std::make_unique<YoshidaIntegrator>());
+    } else if (options.integrator == "respa") {
+        simulation.setIntegrator(
+            std::make_unique<RespaIntegrator>(options.respaInnerSteps)
+        );
+    }
+    if (options.solver == "fmm") {
+        simulation.setSolver(std::make_unique<FmmSolver>(options.fmmOrder));
+    } else if (options.solver == "direct") {
+        simulation.setSolver(std::make_unique<DirectSumSolver>());
+    } else {
+        simulation.setSolver(
+            std::make_unique<BarnesHutSolver>(options.groupSize)
+        );
+    }
+
+    if (!World::load(options.source, simulation)) {
+        return 1;
+    }
+
+    std::unique_ptr<TrajectoryRecorder> recorder;
+    if (options.recordPath) {
+        recorder = std::make_unique<TrajectoryRecorder>(
+            options.recordPath,
+            options.recordEvery,
+            options.recordBuffers,
+            options.recordDrop
+                ? TrajectoryRecorder::WhenFull::drop
+                : TrajectoryRecorder::WhenFull::wait
+        );
+        if (!recorder->isOpen()) {
+            std::cerr<<"could not open "<<options.recordPath<<std::endl;
+            return 1;
+        }
+    }
+
+    if (options.statsPath && !Profile::enabled) {
+        std::cerr
+            <<"built without PARSIM_PROFILE, "<<options.statsPath
+            <<" only gets the update count"<<std::endl;
+    }
+    bool const statsPerUpdate =
+        options.statsPath && endsWith(options.statsPath, ".csv");
+    std::vector<Profile> profiles;
+
+    size_t const bodies = simulation.size();
+    auto const start = std::chrono::steady_clock::now();
+    for (size_t step = 0; step < options.steps; step++) {
+        simulation.update(options.dt);
+        if (recorder) {
+            recorder->record(simulation);
+        }
+        if (statsPerUpdate) {
+            profiles.push_back(simulation.stats().last);
+        }
+    }
+    auto const end = std::chrono::steady_clock::now();
+
+    double const
+        seconds = std::chrono::duration<double>(end - start).count()
+    ,   stepsPerSec = options.steps / seconds
+    ;
+    std::cout
+        <<"bodies: "<<bodies<<std::endl;
+    if (simulation.size() != bodies) {
+        std::cout<<"bodies left: "<<simulation.size()<<std::endl;
+    }
+    std::cout
+        <<"steps: "<<options.steps<<std::endl
+        <<"threads: "<<simulation.threadCount()<<std::endl
+        <<"seconds: "<<seconds<<std::endl
+        <<"steps/sec: "<<stepsPerSec<<std::endl
+        <<"bodies*steps/sec: "<<stepsPerSec * bodies<<std::endl;
+    if (Profile::enabled) {
+        Profile const& total = simulation.stats().total;
+        for (size_t p = 0; p < Profile::phaseCount; p++) {
+            std::cout
+                <<phaseName(Phase(p))<<" ms/update: "
+                <<total.seconds[p] * 1e3 / options.steps<<std::endl;
+        }
+        std::cout
+            <<"node visits/update: "
+            <<total.nodeVisits / double(options.steps)<<std::endl
+            <<"tree depth: "<<total.treeDepth<<std::endl;
+    }
+    if (recorder) {
+        // the frames still in the ring aren't part of the timing
+        recorder->flush();
+        TrajectoryRecorder::Stats const stats = recorder->stats();
+        std::cout
+            <<"frames recorded: "<<stats.recorded<<std::endl
+            <<"frames dropped: "<<stats.dropped<<std::endl
+            <<"recorder waits: "<<stats.waits<<std::endl
+            <<"recorded bytes: "<<stats.bytesWritten
+            <<" of "<<stats.rawBytes<<std::endl;
+        if (stats.writeFailed) {
+            std::cerr<<"could not write "<<options.recordPath<<std::endl;
+            return 1;
+        }
+    }
+
+    if (options.statsPath) {
+        std::ofstream out(options.statsPath);
+        if (statsPerUpdate) {
+            out<<"update,";
+            Profile::writeCsvHeader(out);
+            out<<std::endl;
+            for (size_t u = 0; u < profiles.size(); u++) {
+                out<<u<<",";
+                profiles[u].writeCsvRow(out);
+                out<<std::endl;
+            }
+        } else {
+            simulation.stats().writeJson(out);
+        }
+        if (!out) {
+            std::cerr<<"could not write "<<options.statsPath<<std::endl;
+            return 1;
+        }
+    }
+
+    if (options.savePath) {
+        Snapshot::Status const status =
+            Snapshot::write(simulation, options.savePath);
+        if (status != Snapshot::Status::ok) {
+            std::cerr
+                <<options.savePath<<": "<<Snapshot::describe(status)
+                <<std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cmath>
+
+#include "integrator.hpp"
+#include "simulation.hpp"
+
+void Integrator::start(Simulation& simulation) {
+    simulation.computeForces();
+}
+
+void EulerIntegrator::step(Simulation& simulation, float dt) {
+    simulation.drift(dt);
+    simulation.kick(dt);
+    simulation.computeForces();
+}
+
+void LeapfrogIntegrator::step(Simulation& simulation, float dt) {
+    simulation.kick(dt / 2.f);
+    simulation.drift(dt);
+    simulation.computeForces();
+    simulation.kick(dt / 2.f);
+}
+
+void YoshidaIntegrator::step(Simulation& simulation, float dt) {
+    double const
+        cbrt2 = std::cbrt(2.)
+    ,   w1 = 1. / (2. - cbrt2)
+    ,   w0 = -cbrt2 / (2. - cbrt2)
+    ;
+    LeapfrogIntegrator leapfrog;
+    leapfrog.step(simulation, float(w1 * dt));
+    leapfrog.step(simulation, float(w0 * dt));
+    leapfrog.step(simulation, float(w1 * dt));
+}
+
+RespaIntegrator::RespaIntegrator(size_t _innerSteps)
+: innerSteps(std::max(_innerSteps, size_t(1))) {}
+
+void RespaIntegrator::start(Simulation& simulation) {
+    simulation.computeSplitForces();
+}
+
+void RespaIntegrator::step(Simulation& simulation, float dt) {
+    float const innerDt = dt / innerSteps;
+    simulation.kickFar(dt / 2.f);
+    for (size_t i = 0; i < innerSteps; i++) {
+        simulation.kick(innerDt / 2.f);
+        simulation.drift(innerDt);
+        simulation.computeNearForces();
+        simulation.kick(innerDt / 2.f);
+    }
+    // The new tree may move bodies to the other side of the split. The
+    // closing far kick has to use the split the step started with, so it
+    // takes the total force minus the near part of the old split.
+    oldNear = simulation.forces;
+    simulation.computeSplitForces();
+    newFar = simulation.farForces;
+    for (size_t e = 0; e < simulation.size(); e++) {
+        simulation.farForces[e] += simulation.forces[e] - oldNear[e];
+    }
+    simulation.kickFar(dt / 2.f);
+    simulation.farForces.swap(newFar);
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef PARSIM_INTEGRATOR_H
+#define PARSIM_INTEGRATOR_H
+
+#include <cstddef>
+#include <vector>
+
+#include "common.hpp"
+
+class Simulation;
+
+// Advances positions and velocities by one substep. `start` computes the
+// forces the integrator needs at the current positions, once per
+// `Simulation::update`, and `step` must leave them current again on exit,
+// so schemes that end on a force evaluation hand it to the next step for
+// free.
+class Integrator {
+public:
+    virtual ~Integrator() = default;
+    // `simulation.computeForces()` by default
+    virtual void start(Simulation& simulation);
+    virtual void step(Simulation& simulation, float dt) = 0;
+};
+
+// x += v dt, v += a dt. First order and not symplectic, kept to compare
+// against.
+class EulerIntegrator : public Integrator {
+public:
+    void step(Simulation& simulation, float dt) override;
+};
+
+// Kick-drift-kick leapfrog: second order, symplectic, one force evaluation
+// per step.
+class LeapfrogIntegrator : public Integrator {
+public:
+    void step(Simulation& simulation, float dt) override;
+};
+
+// Yoshida's 4th order composition (the same as Forest-Ruth): three leapfrog
+// steps of w1 dt, w0 dt and w1 dt. Three force evaluations per step, but the
+// error falls with dt^4, so it takes far fewer steps than leapfrog for the
+// same accuracy.
+class YoshidaIntegrator : public Integrator {
+public:
+    void step(Simulation& simulation, float dt) override;
+};
+
+// Impulse RESPA multiple time stepping: the far field (`farForces`) kicks
+// half a step at both ends of `dt`, and in between `innerSteps` leapfrog
+// steps move the bodies under the near field (`forces`) alone. The far
+// field is computed once per step, the near field once per inner step and
+// once more on the old split at the end of the step.
+class RespaIntegrator : public Integrator {
+public:
+    size_t innerSteps;
+
+    explicit RespaIntegrator(size_t _innerSteps = 4);
+    void start(Simulation& simulation) override;
+    void step(Simulation& simulation, float dt) override;
+
+private:
+    std::vector<RealVec2> oldNear;
+    std::vector<RealVec2> newFar;
+};
+
+#endif /* PARSIM_INTEGRATOR_H */
\ No newline at end of file
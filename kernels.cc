@@ -0,0 +1,231 @@
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "kernels.hpp"
+
+namespace {
+// The vector operations `directSum` is written in, per scalar type and
+// instruction set. Without a specialization the kernel is scalar only.
+template <typename Scalar>
+struct Lanes {
+    static constexpr size_t width = 1;
+};
+
+#if defined(__AVX__)
+template <>
+struct Lanes<float> {
+    using V = __m256;
+    static constexpr size_t width = 8;
+
+    static V set(float a) { return _mm256_set1_ps(a); }
+    static V load(float const *p) { return _mm256_loadu_ps(p); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    // m / r^3 where r2 > 0, 0 elsewhere
+    static V weight(V m, V r2) {
+        V const
+            zero = _mm256_setzero_ps()
+        ,   r3 = _mm256_mul_ps(r2, _mm256_sqrt_ps(r2))
+        ,   apart = _mm256_cmp_ps(r2, zero, _CMP_GT_OQ)
+        ;
+        return _mm256_and_ps(apart, _mm256_div_ps(m, r3));
+    }
+    static float sum(V v) {
+        __m128 sum = _mm_add_ps(
+            _mm256_castps256_ps128(v),
+            _mm256_extractf128_ps(v, 1)
+        );
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0b01));
+        return _mm_cvtss_f32(sum);
+    }
+};
+
+template <>
+struct Lanes<double> {
+    using V = __m256d;
+    static constexpr size_t width = 4;
+
+    static V set(double a) { return _mm256_set1_pd(a); }
+    static V load(double const *p) { return _mm256_loadu_pd(p); }
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V weight(V m, V r2) {
+        V const
+            zero = _mm256_setzero_pd()
+        ,   r3 = _mm256_mul_pd(r2, _mm256_sqrt_pd(r2))
+        ,   apart = _mm256_cmp_pd(r2, zero, _CMP_GT_OQ)
+        ;
+        return _mm256_and_pd(apart, _mm256_div_pd(m, r3));
+    }
+    static double sum(V v) {
+        __m128d sum = _mm_add_pd(
+            _mm256_castpd256_pd128(v),
+            _mm256_extractf128_pd(v, 1)
+        );
+        sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+        return _mm_cvtsd_f64(sum);
+    }
+};
+#elif defined(__SSE2__)
+template <>
+struct Lanes<float> {
+    using V = __m128;
+    static constexpr size_t width = 4;
+
+    static V set(float a) { return _mm_set1_ps(a); }
+    static V load(float const *p) { return _mm_loadu_ps(p); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    // m / r^3 where r2 > 0, 0 elsewhere
+    static V weight(V m, V r2) {
+        V const
+            r3 = _mm_mul_ps(r2, _mm_sqrt_ps(r2))
+        ,   apart = _mm_cmpgt_ps(r2, _mm_setzero_ps())
+        ;
+        return _mm_and_ps(apart, _mm_div_ps(m, r3));
+    }
+    static float sum(V sum) {
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0b01));
+        return _mm_cvtss_f32(sum);
+    }
+};
+
+template <>
+struct Lanes<double> {
+    using V = __m128d;
+    static constexpr size_t width = 2;
+
+    static V set(double a) { return _mm_set1_pd(a); }
+    static V load(double const *p) { return _mm_loadu_pd(p); }
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V weight(V m, V r2) {
+        V const
+            r3 = _mm_mul_pd(r2, _mm_sqrt_pd(r2))
+        ,   apart = _mm_cmpgt_pd(r2, _mm_setzero_pd())
+        ;
+        return _mm_and_pd(apart, _mm_div_pd(m, r3));
+    }
+    static double sum(V sum) {
+        sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+        return _mm_cvtsd_f64(sum);
+    }
+};
+#endif
+}
+
+template <typename Scalar>
+BasicVec2<Scalar> directSum(
+    BasicVec2<Scalar> position,
+    Scalar const *x,
+    Scalar const *y,
+    Scalar const *m,
+    size_t n
+) {
+    BasicVec2<Scalar> pull = {0, 0};
+    size_t j = 0;
+    if constexpr (Lanes<Scalar>::width > 1) {
+        using L = Lanes<Scalar>;
+        typename L::V const
+            px = L::set(position.x)
+        ,   py = L::set(position.y)
+        ;
+        typename L::V
+            sumX = L::set(0)
+        ,   sumY = L::set(0)
+        ;
+        for (; j + L::width <= n; j += L::width) {
+            typename L::V const
+                dx = L::sub(L::load(x + j), px)
+            ,   dy = L::sub(L::load(y + j), py)
+            ,   r2 = L::add(L::mul(dx, dx), L::mul(dy, dy))
+            ,   w = L::weight(L::load(m + j), r2)
+            ;
+            sumX = L::add(sumX, L::mul(w, dx));
+            sumY = L::add(sumY, L::mul(w, dy));
+        }
+        pull.x = L::sum(sumX);
+        pull.y = L::sum(sumY);
+    }
+    for (; j < n; j++) {
+        Scalar const
+            dx = x[j] - position.x
+        ,   dy = y[j] - position.y
+        ,   r2 = dx * dx + dy * dy
+        ;
+        if (r2 > 0) {
+            Scalar const w = m[j] / (r2 * std::sqrt(r2));
+            pull.x += w * dx;
+            pull.y += w * dy;
+        }
+    }
+    return pull;
+}
+
+template <typename Scalar>
+BasicVec2<Scalar> quadrupoleSum(
+    BasicVec2<Scalar> position,
+    Scalar const *x,
+    Scalar const *y,
+    Scalar const *qxx,
+    Scalar const *qxy,
+    Scalar const *qyy,
+    size_t n
+) {
+    // plain enough for the compiler to vectorize
+    Scalar sumX = 0, sumY = 0;
+    for (size_t j = 0; j < n; j++) {
+        BasicVec2<Scalar> const pull = quadrupolePull(
+            x[j] - position.x,
+            y[j] - position.y,
+            qxx[j],
+            qxy[j],
+            qyy[j]
+        );
+        sumX += pull.x;
+        sumY += pull.y;
+    }
+    return {sumX, sumY};
+}
+
+template Vec2 directSum(
+    Vec2,
+    float const *,
+    float const *,
+    float const *,
+    size_t
+);
+template BasicVec2<double> directSum(
+    BasicVec2<double>,
+    double const *,
+    double const *,
+    double const *,
+    size_t
+);
+template Vec2 quadrupoleSum(
+    Vec2,
+    float const *,
+    float const *,
+    float const *,
+    float const *,
+    float const *,
+    size_t
+);
+template BasicVec2<double> quadrupoleSum(
+    BasicVec2<double>,
+    double const *,
+    double const *,
+    double const *,
+    double const *,
+    double const *,
+    size_t
+);
\ No newline at end of file
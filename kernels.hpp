@@ -0,0 +1,66 @@
+#ifndef PARSIM_KERNELS_H
+#define PARSIM_KERNELS_H
+
+#include <cstddef>
+
+#include "common.hpp"
+
+// The kernels are templates over the scalar type, instantiated in kernels.cc
+// for float and double.
+
+// Sums m[j] * (p[j] - position) / |p[j] - position|^3 over the bodies
+// [0, n) of SoA position/mass columns, skipping bodies at distance 0 (so a
+// body can be summed against the leaf it sits in). Multiplied by G and the
+// mass of the body at `position` that is the force on it.
+//
+// Uses AVX when the build targets it (-march=native in release builds), SSE
+// otherwise, and a scalar loop for the remainder.
+template <typename Scalar>
+BasicVec2<Scalar> directSum(
+    BasicVec2<Scalar> position,
+    Scalar const *x,
+    Scalar const *y,
+    Scalar const *m,
+    size_t n
+);
+
+// The quadrupole part of the pull of a node whose center of mass is at
+// (dx, dy) from the body, with q = sum(m * d * d^T) about that center. It's
+// the gradient of 1/2 sum(q_ij d_i d_j (1/r)).
+template <typename Scalar>
+static inline BasicVec2<Scalar> quadrupolePull(
+    Scalar dx,
+    Scalar dy,
+    Scalar qxx,
+    Scalar qxy,
+    Scalar qyy
+) {
+    Scalar const
+        invR2 = Scalar(1) / (dx * dx + dy * dy)
+    ,   invR5 = invR2 * invR2 * std::sqrt(invR2)
+    ,   qdx = qxx * dx + qxy * dy
+    ,   qdy = qxy * dx + qyy * dy
+    ,   dqd = dx * qdx + dy * qdy
+    ,   radial = (Scalar(1.5) * (qxx + qyy) - Scalar(7.5) * dqd * invR2)
+            * invR5
+    ;
+    return {
+        Scalar(-3) * qdx * invR5 - radial * dx,
+        Scalar(-3) * qdy * invR5 - radial * dy,
+    };
+}
+
+// `quadrupolePull` summed over the nodes [0, n) of SoA columns, the
+// monopole part of the same nodes is a `directSum`
+template <typename Scalar>
+BasicVec2<Scalar> quadrupoleSum(
+    BasicVec2<Scalar> position,
+    Scalar const *x,
+    Scalar const *y,
+    Scalar const *qxx,
+    Scalar const *qxy,
+    Scalar const *qyy,
+    size_t n
+);
+
+#endif /* PARSIM_KERNELS_H */
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #include <string>
@@ -11,7 +12,9 @@
 #include <raylib.h>
 
 #include "simulation.hpp"
-#include "body_csv_reader.hpp"
+#include "simulation_runner.hpp"
+#include "draw_list.hpp"
+#include "world.hpp"
 #define DEBUGGING
 #include "util.hpp"
 
@@ -32,40 +35,30 @@ int main(void) {
     SetTargetFPS(60);
     SetWindowMonitor(GetCurrentMonitor());
 
-    Rectangle viewport;
-    viewport.x = -GetScreenWidth() * 3.f;
-    viewport.y = -GetScreenHeight() * 3.f;
-    viewport.width = GetScreenWidth() * 6.f;
-    viewport.height = GetScreenHeight() * 6.f;
-    Simulation simulation(
-        {
-            MaterialInfo {"A", 2.e8f},
-            MaterialInfo {"B", 1.5e3f},
-        },
-        viewport,
-        0.5f,
-        Vector2 {GetScreenWidth() / 2.f, GetScreenHeight() / 2.f}
+    Simulation simulation = World::create(
+        Vec2 {float(GetScreenWidth()), float(GetScreenHeight())}
     );
     simulation.scale = 0.2f;
-
-    Vector2 center = {GetScreenWidth() / 2.f, GetScreenHeight() / 2.f};
-    DUMP(center);
-    {
-        std::ifstream bodiesFile("bodies.csv");
-        DUMP(bodiesFile.is_open());
-        BodyCSVReader reader(bodiesFile);
-        reader.readInto(simulation);
-    }
-
-    for (auto& position : simulation.positions) {
-        position += center;
-    }
+    // starts out empty when bodies.csv can't be read
+    World::load({"bodies.csv"}, simulation);
 
     if (!IsWindowReady()) {
         return 1;
     }
 
-    float dt = 1.f / 200.f;
+    View view = {
+        simulation.pointer,
+        simulation.referencePoint,
+        simulation.scale,
+    };
+    // the simulation is only touched by the runner from here on
+    SimulationRunner::Controls controls;
+    SimulationRunner runner(simulation, controls);
+    LodSettings lod;
+    lod.overlayDepth = 4;
+    // the phase timings, when they're built in
+    bool showProfile = Profile::enabled;
+    DrawList drawList;
     while (!WindowShouldClose()) {
         // TODO: Must be `Simulation::Commands`, put the construction in a
         //       function
@@ -100,73 +93,118 @@ int main(void) {
         commands.ptrDown = IsKeyDown(KEY_S);
         commands.ptrLeft = IsKeyDown(KEY_A);
         commands.ptrRight = IsKeyDown(KEY_D);
+        // once per press, the overlay goes from none to the whole tree
+        if (IsKeyPressed(KEY_PERIOD)) {
+            lod.overlayDepth = std::min<int>(lod.overlayDepth + 1, 32);
+        }
+        if (IsKeyPressed(KEY_COMMA)) {
+            lod.overlayDepth = std::max(lod.overlayDepth - 1, -1);
+        }
+        if (IsKeyPressed(KEY_P)) {
+            showProfile = !showProfile && Profile::enabled;
+        }
 
         // TODO: Move this inside the simulation
         constexpr float const
             forceAmount = 1.e14f
         ,   pointerDX = 5.f
         ;
-        simulation.externalForce = {0.f, 0.f};
+        controls.externalForce = {0.f, 0.f};
         if (commands.zoomIn) {
-            simulation.scale += 0.01f;
+            view.scale += 0.01f;
         }
         if (commands.zoomOut) {
-            simulation.scale -= 0.01f;
+            view.scale -= 0.01f;
         }
         if (commands.up) {
-            simulation.externalForce.y -= forceAmount;
+            controls.externalForce.y -= forceAmount;
         }
         if (commands.down) {
-            simulation.externalForce.y += forceAmount;
+            controls.externalForce.y += forceAmount;
         }
         if (commands.left) {
-            simulation.externalForce.x -= forceAmount;
+            controls.externalForce.x -= forceAmount;
         }
         if (commands.right) {
-            simulation.externalForce.x += forceAmount;
+            controls.externalForce.x += forceAmount;
         }
 
+        controls.stopFirstBody = commands.stop;
         if (commands.stop) {
-            simulation.externalForce = {0.f, 0.f};
-            simulation.velocities[0] = {0.f, 0.f};
+            controls.externalForce = {0.f, 0.f};
         }
         if (commands.faster) {
-            dt *= 1.1f;
+            controls.dt *= 1.1f;
         }
         if (commands.slower) {
-            dt /= 1.2f;
+            controls.dt /= 1.2f;
         }
 
         if (commands.ptrUp) {
-            simulation.pointer.y -= pointerDX;
+            view.pointer.y -= pointerDX;
         }
         if (commands.ptrDown) {
-            simulation.pointer.y += pointerDX;
+            view.pointer.y += pointerDX;
         }
         if (commands.ptrLeft) {
-            simulation.pointer.x -= pointerDX;
+            view.pointer.x -= pointerDX;
         }
         if (commands.ptrRight) {
-            simulation.pointer.x += pointerDX;
+            view.pointer.x += pointerDX;
         }
 
         if (commands.zoomIn || commands.zoomOut) {
-            simulation.referencePoint = simulation.pointer;
+            view.referencePoint = view.pointer;
         }
+        runner.setControls(controls);
+        // whatever the simulation thread finished last, it doesn't wait
+        // for the frame and the frame doesn't wait for it
+        RenderState const& state = runner.latest();
+        lod.screen = {
+            0.f,
+            0.f,
+            float(GetScreenWidth()),
+            float(GetScreenHeight()),
+        };
+        selectDrawList(state, view, lod, drawList);
 
         std::ostringstream ss;
-        ss<<"dt = "<<std::fixed<<std::setprecision(6)<<dt;
+        ss<<"dt = "<<std::fixed<<std::setprecision(6)<<controls.dt;
         std::string dtMsg = ss.str();
-        ss.seekp(0);
-        ss.clear();
-        ss<<"scale = "<<std::fixed<<std::setprecision(2)<<simulation.scale;
+        ss.str("");
+        ss<<"scale = "<<std::fixed<<std::setprecision(2)<<view.scale;
         std::string scaleMsg = ss.str();
+        ss.str("");
+        ss<<"t = "<<std::fixed<<std::setprecision(2)<<state.time
+            <<" ("<<state.updates<<" updates)";
+        std::string timeMsg = ss.str();
+        std::vector<std::string> profileMsgs;
+        if (showProfile) {
+            Profile const& profile = state.profile;
+            for (size_t p = 0; p < Profile::phaseCount; p++) {
+                ss.str("");
+                ss<<phaseName(Phase(p))<<" = "<<std::fixed
+                    <<std::setprecision(2)<<profile.seconds[p] * 1e3<<" ms";
+                profileMsgs.push_back(ss.str());
+            }
+            double const bodies = std::max<size_t>(state.positions.size(), 1);
+            ss.str("");
+            ss<<"node visits per body = "<<std::fixed<<std::setprecision(1)
+                <<profile.nodeVisits / bodies;
+            profileMsgs.push_back(ss.str());
+            ss.str("");
+            ss<<"tree depth = "<<profile.treeDepth;
+            profileMsgs.push_back(ss.str());
+        }
         BeginDrawing();
-        simulation.update(dt);
         ClearBackground(RAYWHITE);
-        simulation.draw();
+        draw(drawList, view);
         DrawText(dtMsg.c_str(), 5, 0, 20, BLACK);
         DrawText(scaleMsg.c_str(), 5, 23, 20, BLACK);
+        DrawText(timeMsg.c_str(), 5, 46, 20, BLACK);
+        for (size_t i = 0; i < profileMsgs.size(); i++) {
+            DrawText(profileMsgs[i].c_str(), 5, 75 + 18 * i, 16, DARKGRAY);
+        }
         EndDrawing();
     }
     return 0;
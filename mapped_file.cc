@@ -0,0 +1,58 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.hpp"
+
+MappedFile::MappedFile(char const *path) {
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0) {
+        if (info.st_size == 0) {
+            opened = true;
+        } else {
+            void *mapped = mmap(
+                nullptr,
+                info.st_size,
+                PROT_READ,
+                MAP_PRIVATE,
+                fd,
+                0
+            );
+            if (mapped != MAP_FAILED) {
+                madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+                opened = true;
+                bytes = static_cast<unsigned char const *>(mapped);
+                length = info.st_size;
+            }
+        }
+    }
+    // the mapping keeps the file alive on its own
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) {
+        munmap(const_cast<unsigned char *>(bytes), length);
+    }
+}
+
+bool MappedFile::isOpen() const {
+    return opened;
+}
+
+unsigned char const *MappedFile::data() const {
+    return bytes;
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
+
+std::string_view MappedFile::text() const {
+    return {reinterpret_cast<char const *>(bytes), length};
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef PARSIM_MAPPED_FILE_H
+#define PARSIM_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string_view>
+
+// A whole file mapped read-only for as long as the object lives. The kernel
+// is told it'll be read front to back.
+class MappedFile {
+public:
+    explicit MappedFile(char const *path);
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile();
+
+    // false if the file couldn't be opened, an empty file is open but has
+    // no data
+    bool isOpen() const;
+    unsigned char const *data() const;
+    size_t size() const;
+    std::string_view text() const;
+
+private:
+    bool opened = false;
+    unsigned char const *bytes = nullptr;
+    size_t length = 0;
+};
+
+#endif /* PARSIM_MAPPED_FILE_H */
\ No newline at end of file
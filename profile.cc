@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+#include "profile.hpp"
+
+namespace {
+struct Counter {
+    char const *name;
+    uint64_t Profile::*value;
+};
+
+constexpr Counter counters[] = {
+    {"nodesCreated", &Profile::nodesCreated},
+    {"treeDepth", &Profile::treeDepth},
+    {"nodeVisits", &Profile::nodeVisits},
+    {"cellInteractions", &Profile::cellInteractions},
+    {"bodyInteractions", &Profile::bodyInteractions},
+};
+}
+
+char const *phaseName(Phase phase) {
+    switch (phase) {
+    case Phase::update:
+        return "update";
+    case Phase::substep:
+        return "substep";
+    case Phase::buildTree:
+        return "buildTree";
+    case Phase::nodeMasses:
+        return "nodeMasses";
+    case Phase::forces:
+        return "forces";
+    case Phase::kick:
+        return "kick";
+    case Phase::drift:
+        return "drift";
+    case Phase::collisions:
+        return "collisions";
+    case Phase::count:
+        break;
+    }
+    return "?";
+}
+
+double Profile::secondsIn(Phase phase) const {
+    return seconds[size_t(phase)];
+}
+
+uint64_t Profile::callsOf(Phase phase) const {
+    return calls[size_t(phase)];
+}
+
+void Profile::addTime(Phase phase, double elapsed) {
+    seconds[size_t(phase)] += elapsed;
+    calls[size_t(phase)]++;
+}
+
+void Profile::addInteractions(
+    GravitySolver::Interactions const& interactions
+) {
+    nodeVisits += interactions.visits;
+    cellInteractions += interactions.cells;
+    bodyInteractions += interactions.bodies;
+}
+
+void Profile::add(Profile const& other) {
+    for (size_t p = 0; p < phaseCount; p++) {
+        seconds[p] += other.seconds[p];
+        calls[p] += other.calls[p];
+    }
+    uint64_t const depth = std::max(treeDepth, other.treeDepth);
+    for (Counter const& counter : counters) {
+        this->*counter.value += other.*counter.value;
+    }
+    treeDepth = depth;
+}
+
+void Profile::clear() {
+    *this = Profile();
+}
+
+void Profile::writeCsvHeader(std::ostream& o) {
+    char const *separator = "";
+    for (size_t p = 0; p < phaseCount; p++) {
+        std::string const name = phaseName(Phase(p));
+        o<<separator<<name<<"Seconds,"<<name<<"Calls";
+        separator = ",";
+    }
+    for (Counter const& counter : counters) {
+        o<<","<<counter.name;
+    }
+}
+
+void Profile::writeCsvRow(std::ostream& o) const {
+    char const *separator = "";
+    for (size_t p = 0; p < phaseCount; p++) {
+        o<<separator<<seconds[p]<<","<<calls[p];
+        separator = ",";
+    }
+    for (Counter const& counter : counters) {
+        o<<","<<this->*counter.value;
+    }
+}
+
+void Profile::writeJson(std::ostream& o, size_t indent) const {
+    std::string const
+        outer(indent, ' ')
+    ,   inner(indent + 4, ' ')
+    ,   innermost(indent + 8, ' ')
+    ;
+    o<<"{"<<std::endl<<inner<<"\"phases\": {"<<std::endl;
+    for (size_t p = 0; p < phaseCount; p++) {
+        o
+            <<innermost<<"\""<<phaseName(Phase(p))<<"\": "
+            <<"{\"seconds\": "<<seconds[p]<<", \"calls\": "<<calls[p]<<"}"
+            <<(p + 1 < phaseCount ? "," : "")<<std::endl;
+    }
+    o<<inner<<"},"<<std::endl;
+    size_t const counterCount = std::size(counters);
+    for (size_t c = 0; c < counterCount; c++) {
+        o
+            <<inner<<"\""<<counters[c].name<<"\": "
+            <<this->*counters[c].value
+            <<(c + 1 < counterCount ? "," : "")<<std::endl;
+    }
+    o<<outer<<"}";
+}
+
+void Stats::writeJson(std::ostream& o) const {
+    o
+        <<"{"<<std::endl
+        <<"    \"profiling\": "<<(Profile::enabled ? "true" : "false")<<","
+        <<std::endl
+        <<"    \"updates\": "<<updates<<","<<std::endl
+        <<"    \"last\": ";
+    last.writeJson(o, 4);
+    o<<","<<std::endl<<"    \"total\": ";
+    total.writeJson(o, 4);
+    o<<std::endl<<"}"<<std::endl;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#ifndef PARSIM_PROFILE_H
+#define PARSIM_PROFILE_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#include "gravity_solver.hpp"
+
+// Where the time of an update goes and how much work the tree does, only
+// collected when built with `PARSIM_PROFILE`. Otherwise `PARSIM_TIME` and
+// `PARSIM_COUNT` expand to nothing and the stats stay zero.
+#ifdef PARSIM_PROFILE
+#define PARSIM_PROFILING true
+#else
+#define PARSIM_PROFILING false
+#endif
+
+enum class Phase {
+    // all of `Simulation::update`
+    update,
+    // one integrator step and the collisions after it, or one tick with
+    // block timesteps
+    substep,
+    buildTree,
+    nodeMasses,
+    // the solver, plus turning fields into forces
+    forces,
+    kick,
+    drift,
+    collisions,
+    count,
+};
+
+char const *phaseName(Phase phase);
+
+struct Profile {
+    static constexpr size_t phaseCount = size_t(Phase::count);
+    static constexpr bool enabled = PARSIM_PROFILING;
+
+    std::array<double, phaseCount> seconds{};
+    std::array<uint64_t, phaseCount> calls{};
+    // nodes laid out by builds, refits that keep every body in its leaf
+    // don't count
+    uint64_t nodesCreated = 0;
+    // of the deepest tree built
+    uint64_t treeDepth = 0;
+    // summed over the solver's walks, see `GravitySolver::Interactions`
+    uint64_t nodeVisits = 0;
+    uint64_t cellInteractions = 0;
+    uint64_t bodyInteractions = 0;
+
+    double secondsIn(Phase phase) const;
+    uint64_t callsOf(Phase phase) const;
+    void addTime(Phase phase, double elapsed);
+    void addInteractions(GravitySolver::Interactions const& interactions);
+    // sums everything but `treeDepth`, which keeps the deepest
+    void add(Profile const& other);
+    void clear();
+
+    // the columns of `writeCsvRow`
+    static void writeCsvHeader(std::ostream& o);
+    void writeCsvRow(std::ostream& o) const;
+    // an object with a member per phase and per counter
+    void writeJson(std::ostream& o, size_t indent = 0) const;
+};
+
+// What `Simulation::stats` returns.
+struct Stats {
+    // of the last finished update
+    Profile last;
+    // of every update since `Simulation::resetStats`
+    Profile total;
+    uint64_t updates = 0;
+
+    // `last` and `total` along with `updates` and whether profiling was
+    // built in
+    void writeJson(std::ostream& o) const;
+};
+
+// adds the time from construction to destruction to `phase`
+class ScopedTimer {
+public:
+    ScopedTimer(Profile& _profile, Phase _phase)
+    : profile(_profile)
+    , phase(_phase)
+    , start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        std::chrono::duration<double> const elapsed =
+            std::chrono::steady_clock::now() - start;
+        profile.addTime(phase, elapsed.count());
+    }
+    ScopedTimer(ScopedTimer const&) = delete;
+    ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+private:
+    Profile& profile;
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define PARSIM_CONCAT_(a, b) a##b
+#define PARSIM_CONCAT(a, b) PARSIM_CONCAT_(a, b)
+
+#ifdef PARSIM_PROFILE
+// times the rest of the enclosing scope
+#define PARSIM_TIME(profile, phase)                                         \
+    ScopedTimer const PARSIM_CONCAT(parsimTimer, __LINE__)(profile, phase)
+// statements that only run when profiling
+#define PARSIM_COUNT(...) __VA_ARGS__
+#else
+#define PARSIM_TIME(profile, phase)
+#define PARSIM_COUNT(...)
+#endif /* PARSIM_PROFILE */
+
+#endif /* PARSIM_PROFILE_H */
\ No newline at end of file
@@ -1,179 +1,541 @@
+#include <algorithm>
+#include <cmath>
+
 #include "quad_tree.hpp"
 
-using Node = QuadTree::Node;
+using Index = QuadTree::Index;
 std::ostream& printIndent(std::ostream& o, size_t level);
 
-QuadTree::QuadTree(Rectangle viewport) : nodes({Node(viewport)}) {}
+namespace {
+// bits per axis in a Morton key
+constexpr unsigned mortonLevels = QuadTree::maxDepth;
+
+uint64_t spreadBits(uint32_t v) {
+    uint64_t x = v;
+    x = (x | x << 16) & 0x0000ffff0000ffffull;
+    x = (x | x << 8)  & 0x00ff00ff00ff00ffull;
+    x = (x | x << 4)  & 0x0f0f0f0f0f0f0f0full;
+    x = (x | x << 2)  & 0x3333333333333333ull;
+    x = (x | x << 1)  & 0x5555555555555555ull;
+    return x;
+}
+
+// Maps `value` from [origin, origin + extent] onto a cell on the finest grid.
+// Values exactly on a cell boundary go to the lower cell, the same as the
+// `<=` in `BuildNode::findPartition`, and values outside are clamped to the
+// edge cells like the incremental inserter does.
+uint32_t quantize(float value, float origin, float extent) {
+    double const cells = double(uint64_t(1) << mortonLevels);
+    double const t = std::ceil((double(value) - origin) / extent * cells) - 1.;
+    return uint32_t(std::clamp(t, 0., cells - 1.));
+}
+
+// The two bits of each level are `right` and `bottom`, so the digit at a
+// level is the index of the child the body falls into.
+uint64_t mortonKey(Vec2 pos, Rect const& bounds) {
+    return spreadBits(quantize(pos.x, bounds.x, bounds.width))
+        | spreadBits(quantize(pos.y, bounds.y, bounds.height)) << 1;
+}
+
+// The tree's geometry is in float whatever the precision of the bodies, a
+// body is placed by its position rounded to float.
+Vec2 pointOf(BodyStore<Real> const& store, Entity e) {
+    return {float(store.x[e]), float(store.y[e])};
+}
+
+unsigned partitionAt(uint64_t key, unsigned level) {
+    return (key >> (2 * (mortonLevels - 1 - level))) & 0b11;
+}
+}
+
+QuadTree::QuadTree(
+    Rect _viewport,
+    BuildMode _buildMode,
+    size_t _leafCapacity
+)
+: buildMode(_buildMode)
+, leafCapacity(_leafCapacity)
+, viewport(_viewport) {
+    clear();
+}
 
 void QuadTree::clear() {
-    nodes.resize(1);
-    root() = Node(root().bounds);
+    building.clear();
+    building.add(BuildNode(viewport));
+    bodies.clear();
+    leafOf.clear();
+    hot.clear();
+    cold.clear();
+    quadrupoles.clear();
+    hot.add({{0, 0}, 0, viewport.width, 1, 0, 0});
+    cold.add({viewport, none, 0});
+    quadrupoles.add({0, 0, 0});
+}
+
+Rect const& QuadTree::bounds() const {
+    return viewport;
+}
+
+size_t QuadTree::nodeCount() const {
+    return hot.size();
+}
+
+bool QuadTree::isLeaf(Index i) const {
+    return hot[i].next == i + 1;
+}
+
+unsigned QuadTree::depth() const {
+    float smallest = hot[0].size;
+    for (Hot const& node : hot) {
+        smallest = std::min(smallest, node.size);
+    }
+    // every level halves the cell
+    return unsigned(std::lround(std::log2(hot[0].size / smallest)));
 }
-Node& QuadTree::root() {
-    return nodes[0];
+
+QuadTree::Children QuadTree::children(Index i) const {
+    return {
+        ChildIterator(*this, cold[i].firstChild, cold[i].childMask),
+        ChildIterator(*this, none, 0),
+    };
+}
+
+void QuadTree::build(BodyStore<Real> const& store) {
+    switch (buildMode) {
+    case BuildMode::incremental:
+        clear();
+        leafLinks.resize(store.size());
+        for (Entity e = 0; (size_t)e < store.size(); e++) {
+            insert(e, store);
+        }
+        reorderDepthFirst();
+        gatherLeafBodies();
+        break;
+    case BuildMode::morton:
+        buildMorton(store);
+        break;
+    }
+    layOut();
+    indexLeaves();
+}
+
+QuadTree::Update QuadTree::update(BodyStore<Real> const& store) {
+    size_t const n = store.size();
+    if (leafOf.size() != n) {
+        build(store);
+        return Update::rebuilt;
+    }
+    moved.clear();
+    for (Entity e = 0; (size_t)e < n; e++) {
+        if (!holds(building[leafOf[e]], pointOf(store, e))) {
+            moved.push_back(e);
+        }
+    }
+    if (moved.empty()) {
+        return Update::refitted;
+    }
+    if (moved.size() > rebuildThreshold * n) {
+        build(store);
+        return Update::rebuilt;
+    }
+
+    // Go back to the leaf lists of the incremental build without the bodies
+    // that moved, insert those, and lay the tree out again without the
+    // subtrees that lost all their bodies.
+    for (Entity e : moved) {
+        leafOf[e] = none;
+    }
+    leafLinks.resize(n);
+    for (auto& node : building) {
+        if (node.hasChildren()) {
+            continue;
+        }
+        Index head = none;
+        Index count = 0;
+        for (auto k = node.first; k < node.first + node.count; k++) {
+            Entity const e = bodies[k];
+            if (leafOf[e] == none) {
+                continue;
+            }
+            leafLinks[e] = head;
+            head = e;
+            count++;
+        }
+        node.first = head;
+        node.count = count;
+    }
+    for (Entity e : moved) {
+        insert(e, store);
+    }
+    pruneEmpty();
+    reorderDepthFirst();
+    gatherLeafBodies();
+    layOut();
+    indexLeaves();
+    return Update::reinserted;
+}
+
+void QuadTree::pruneEmpty() {
+    heldCounts.assign(building.size(), 0);
+    // children are always after their parent in `building`, whether laid
+    // out depth-first or added by `insert`
+    for (size_t i = building.size(); i-- > 0;) {
+        BuildNode& node = building[i];
+        if (!node.hasChildren()) {
+            heldCounts[i] = node.count;
+            continue;
+        }
+        Index held = 0;
+        for (unsigned partition = 0; partition < 4; partition++) {
+            if (!node.hasChild(partition)) {
+                continue;
+            }
+            Index const child = node.children[partition];
+            if (heldCounts[child] == 0) {
+                node.children[partition] = none;
+            }
+            held += heldCounts[child];
+        }
+        heldCounts[i] = held;
+    }
+}
+
+void QuadTree::reorderDepthFirst() {
+    reordered.clear();
+    relocations.clear();
+    relocations.push_back({0, none, 0});
+    while (!relocations.empty()) {
+        Relocation const r = relocations.back();
+        relocations.pop_back();
+        Index const i = reordered.add(building[r.from]);
+        if (r.parent != none) {
+            reordered[r.parent].children[r.partition] = i;
+        }
+        BuildNode const& node = building[r.from];
+        for (unsigned partition = 4; partition-- > 0;) {
+            if (node.hasChild(partition)) {
+                relocations.push_back({
+                    node.children[partition], i, partition
+                });
+            }
+        }
+    }
+    building.swap(reordered);
+}
+
+void QuadTree::gatherLeafBodies() {
+    bodies.clear();
+    for (auto& node : building) {
+        if (node.hasChildren()) {
+            continue;
+        }
+        Index held = node.first;
+        node.first = bodies.size();
+        for (; held != none; held = leafLinks[held]) {
+            bodies.push_back(held);
+        }
+    }
+}
+
+void QuadTree::indexLeaves() {
+    leafOf.resize(bodies.size());
+    for (size_t i = 0; i < building.size(); i++) {
+        BuildNode const& node = building[i];
+        if (node.hasChildren()) {
+            continue;
+        }
+        for (auto k = node.first; k < node.first + node.count; k++) {
+            leafOf[bodies[k]] = i;
+        }
+    }
+}
+
+bool QuadTree::holds(BuildNode const& leaf, Vec2 pos) const {
+    Rect const
+        &bounds = leaf.bounds
+    ,   &outer = viewport
+    ;
+    bool const
+        left = bounds.x <= outer.x || pos.x >= bounds.x
+    ,   right = bounds.x + bounds.width >= outer.x + outer.width
+            || pos.x <= bounds.x + bounds.width
+    ,   top = bounds.y <= outer.y || pos.y >= bounds.y
+    ,   bottom = bounds.y + bounds.height >= outer.y + outer.height
+            || pos.y <= bounds.y + bounds.height
+    ;
+    return left && right && top && bottom;
+}
+
+void QuadTree::layOut() {
+    size_t const count = building.size();
+    hot.resize(count);
+    cold.resize(count);
+    quadrupoles.resize(count);
+    // The subtree of a node ends where the subtree of its last child ends,
+    // and its bodies start where the ones of its first child do.
+    for (size_t i = count; i-- > 0;) {
+        BuildNode& node = building[i];
+        Hot& h = hot[i];
+        Cold& c = cold[i];
+        h.size = node.bounds.width;
+        h.next = i + 1;
+        c.bounds = node.bounds;
+        c.firstChild = none;
+        c.childMask = 0;
+        if (node.hasChildren()) {
+            node.first = building[i + 1].first;
+            node.count = 0;
+            c.firstChild = i + 1;
+            for (unsigned partition = 0; partition < 4; partition++) {
+                if (!node.hasChild(partition)) {
+                    continue;
+                }
+                Index const child = node.children[partition];
+                c.childMask |= 1u << partition;
+                node.count += building[child].count;
+                h.next = hot[child].next;
+            }
+        }
+        h.first = node.first;
+        h.count = node.count;
+    }
+}
+
+void QuadTree::buildMorton(BodyStore<Real> const& store) {
+    clear();
+    size_t const n = store.size();
+    if (n == 0) {
+        return;
+    }
+    keyed.resize(n);
+    keyedScratch.resize(n);
+    bodies.resize(n);
+    for (Entity e = 0; (size_t)e < n; e++) {
+        keyed[e] = {mortonKey(pointOf(store, e), viewport), e};
+    }
+
+    // LSD radix sort, a byte per pass. Passes where every key has the same
+    // digit are skipped, which for clustered bodies is most of the high ones.
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        std::array<size_t, 257> offsets{};
+        for (auto const& k : keyed) {
+            offsets[((k.key >> shift) & 0xff) + 1]++;
+        }
+        if (*std::max_element(offsets.begin(), offsets.end()) == n) {
+            continue;
+        }
+        for (size_t d = 1; d < offsets.size(); d++) {
+            offsets[d] += offsets[d - 1];
+        }
+        for (auto const& k : keyed) {
+            keyedScratch[offsets[(k.key >> shift) & 0xff]++] = k;
+        }
+        keyed.swap(keyedScratch);
+    }
+    for (size_t k = 0; k < n; k++) {
+        bodies[k] = keyed[k].e;
+    }
+
+    // Every pending range shares the key prefix of the node it becomes, so
+    // its children are the sub-ranges with the same digit at the next level.
+    // Nodes get created when they are popped, which puts them in depth-first
+    // order with the children of a node in the order of their partitions.
+    pending.clear();
+    pending.push_back({none, 0, 0, n, 0});
+    while (!pending.empty()) {
+        PendingNode const p = pending.back();
+        pending.pop_back();
+        Index i = 0;
+        if (p.parent != none) {
+            BuildNode const child(
+                building[p.parent].childBounds(p.partition)
+            );
+            i = building.add(child);
+            building[p.parent].children[p.partition] = i;
+        }
+        building[i].first = p.begin;
+        building[i].count = p.end - p.begin;
+        if (p.end - p.begin <= leafCapacity || p.level == maxDepth) {
+            continue;
+        }
+        std::array<size_t, 5> split;
+        split[0] = p.begin;
+        split[4] = p.end;
+        for (unsigned q = 1; q < 4; q++) {
+            split[q] = std::partition_point(
+                keyed.begin() + split[q - 1],
+                keyed.begin() + p.end,
+                [&](KeyedEntity const& k) {
+                    return partitionAt(k.key, p.level) < q;
+                }
+            ) - keyed.begin();
+        }
+        for (unsigned q = 4; q-- > 0;) {
+            if (split[q] != split[q + 1]) {
+                pending.push_back({
+                    i, q, split[q], split[q + 1], p.level + 1
+                });
+            }
+        }
+    }
 }
 
 void QuadTree::insert(
     Entity e,
-    std::vector<Vector2> const& positions,
-    Node::Index i
+    BodyStore<Real> const& store,
+    Index i,
+    unsigned depth
 ) {
-    // DUMP(i);
-    QuadTree::Node *node = &nodes.at(i);
-    if (!node->hasEntity() && !node->hasChildren()) {
-        node->e = e;
-        return;
+    BuildNode *node = &building[i];
+    if (!node->hasChildren()) {
+        if ((size_t)node->count < leafCapacity || depth == maxDepth) {
+            leafLinks[e] = node->first;
+            node->first = e;
+            node->count++;
+            return;
+        }
+        // the leaf is full, move the bodies it holds a level down
+        Index held = node->first;
+        node->first = none;
+        node->count = 0;
+        while (held != none) {
+            Index const following = leafLinks[held];
+            insertIntoChild(held, store, i, depth);
+            held = following;
+        }
+    }
+    insertIntoChild(e, store, i, depth);
+}
+
+void QuadTree::insertIntoChild(
+    Entity e,
+    BodyStore<Real> const& store,
+    Index i,
+    unsigned depth
+) {
+    auto const [partition, bounds] =
+        building[i].findPartition(pointOf(store, e));
+    if (!building[i].hasChild(partition)) {
+        Index const j = building.add(BuildNode(bounds));
+        // index again, the add may have moved the nodes
+        building[i].children[partition] = j;
     }
-    if (node->hasEntity() && !node->hasChildren()) {
-        auto const partition = node->findPartition(positions[node->e]);
-        QuadTree::Node child(std::get<1>(partition));
-        size_t j = nodes.size();
-        Entity e0 = node->e;
-        node->children[std::get<0>(partition)] = j;
-        node->e = -1;
-        nodes.push_back(child);
-        insert(e0, positions, j);
-        // reassign because the pointer to the element gets invalidated
-        // after the push
-        node = &nodes.at(i);
-    }
-    auto const partition = node->findPartition(positions[e]);
-    if (!node->hasChild(std::get<0>(partition))) {
-        size_t j = nodes.size();
-        QuadTree::Node child(std::get<1>(partition));
-        node->children[std::get<0>(partition)] = j;
-        nodes.push_back(child);
-        // reassign again after the push
-        node = &nodes.at(i);
-    }
-    insert(e, positions, node->children[std::get<0>(partition)]);
+    insert(e, store, building[i].children[partition], depth + 1);
 }
 
 std::ostream& QuadTree::printNode(
-    QuadTree::Node::Index i,
+    Index i,
     std::ostream& o,
     size_t level
 ) const {
-    Node const& node = nodes[i];
+    Hot const& h = hot[i];
+    Rect const& bounds = cold[i].bounds;
     o<<"Node {"<<std::endl;
-    printIndent(o, level + 1)<<"entity: "<<node.e<<","<<std::endl;
+    if (isLeaf(i)) {
+        printIndent(o, level + 1)<<"bodies: [";
+        for (Index k = h.first; k < h.first + h.count; k++) {
+            o<<(k == h.first ? "" : ", ")<<bodies[k];
+        }
+        o<<"],"<<std::endl;
+    }
     printIndent(o, level + 1)<<"bounds: {"
-        <<"x: "<<node.bounds.x<<", "
-        <<"y: "<<node.bounds.y<<", "
-        <<"width: "<<node.bounds.width<<", "
-        <<"height: "<<node.bounds.height<<"},"<<std::endl;
+        <<"x: "<<bounds.x<<", "
+        <<"y: "<<bounds.y<<", "
+        <<"width: "<<bounds.width<<", "
+        <<"height: "<<bounds.height<<"},"<<std::endl;
     printIndent(o, level + 1)<<"children: [";
-    if (node.hasChildren()) {
+    if (!isLeaf(i)) {
         o<<std::endl;
-        for (auto const childDesc : node) {
+        // label by partition rather than by node index, so trees built in a
+        // different order print the same
+        Children const all = children(i);
+        for (auto child = all.begin(); child != all.end(); ++child) {
+            unsigned const partition = child.partition();
             printIndent(o, level + 1)
                 <<"<"
-                <<(childDesc & Node::bottom ? "bottom" : "top")
+                <<(partition & bottom ? "bottom" : "top")
                 <<", "
-                <<(childDesc & Node::right ? "right" : "left")
+                <<(partition & right ? "right" : "left")
                 <<">: ";
-            printNode(childDesc, o, level + 2)<<std::endl;
+            printNode(*child, o, level + 2)<<std::endl;
         }
         printIndent(o, level + 1);
     }
     return printIndent(o<<"]"<<std::endl, level)<<"}";
 }
 
-Node::Node(
-    Rectangle _bounds,
-    Entity _e,
-    std::array<Node::Index, 4> _children
+QuadTree::ChildIterator::ChildIterator(
+    QuadTree const& _tree,
+    Index _child,
+    unsigned _mask
 )
-: children(_children)
-, bounds(_bounds)
-, e(_e)
-, mass(-1)
-, massCenter({-1, -1}) {}
-
-size_t Node::countChildren() const {
-    return hasChild(top | left) +
-        hasChild(top | right) +
-        hasChild(bottom | left) +
-        hasChild(bottom | right);
-}
-
-bool Node::hasChildren() const {
-    return countChildren() > 0;
-}
-
-bool Node::hasChild(ssize_t i) const {
-    return children[i] >= 0;
-}
+: tree(_tree)
+, child(_child)
+, mask(_mask) {}
 
-bool Node::hasEntity() const {
-    return e >= 0;
+Index QuadTree::ChildIterator::operator*() const {
+    return child;
 }
 
-std::pair<ssize_t, Rectangle> Node::findPartition(Vector2 pos) const {
-    float x_m = bounds.x + bounds.width / 2.f;
-    float y_m = bounds.y + bounds.height / 2.f;
-    ssize_t index = 0;
-    Rectangle rect;
-    rect.x = bounds.x;
-    rect.y = bounds.y;
-    rect.width = bounds.width / 2.f;
-    rect.height = bounds.height / 2.f;
-    index  |= pos.x <= x_m ? left : right;
-    index  |= pos.y <= y_m ? top : bottom;
-    rect.x += pos.x <= x_m ? 0.f : rect.width;
-    rect.y += pos.y <= y_m ? 0.f : rect.height;
-    return {index, rect};
+unsigned QuadTree::ChildIterator::partition() const {
+    return __builtin_ctz(mask);
 }
 
-Node::iterator Node::begin() const {
-    if (!hasChildren()) {
-        return end();
-    }
-    size_t first = 0;
-    for (; first < 4 && !hasChild(first); first++) {}
-    return iterator(*this, first);
-}
-Node::iterator Node::end() const {
-    return iterator(*this, 4);
+QuadTree::ChildIterator& QuadTree::ChildIterator::operator++() {
+    child = tree.hot[child].next;
+    mask &= mask - 1;
+    return *this;
 }
 
-Node::iterator::iterator(Node const& _node, size_t _i)
-: node(_node), i(_i) {
-    for (; i < 4 && !node.hasChild(i); i++) {}
+bool QuadTree::ChildIterator::operator!=(ChildIterator const& other) const {
+    return mask != other.mask;
 }
 
-Node::iterator& Node::iterator::operator++() {
-    i++;
-    for (; i < 4 && !node.hasChild(i); i++) {}
-    return *this;
+QuadTree::ChildIterator QuadTree::Children::begin() const {
+    return first;
 }
 
-Node::iterator Node::iterator::operator++(int) {
-    iterator ret = *this;
-    ++(*this);
-    return ret;
+QuadTree::ChildIterator QuadTree::Children::end() const {
+    return last;
 }
 
-bool Node::iterator::operator==(iterator const& other) const {
-    return std::addressof(node) == std::addressof(other.node) &&
-        i == other.i;
-}
+QuadTree::BuildNode::BuildNode(Rect _bounds)
+: bounds(_bounds)
+, children({none, none, none, none})
+, first(none)
+, count(0) {}
 
-bool Node::iterator::operator!=(iterator const& other) const {
-    return !this->operator==(other);
+bool QuadTree::BuildNode::hasChild(unsigned partition) const {
+    return children[partition] != none;
 }
 
-Node::iterator::reference Node::iterator::operator*() const {
-    return *this;
+bool QuadTree::BuildNode::hasChildren() const {
+    return hasChild(top | left)
+        || hasChild(top | right)
+        || hasChild(bottom | left)
+        || hasChild(bottom | right);
 }
 
-template <typename T>
-Node& Node::iterator::getFrom(T& collection) const {
-    return collection.get(i);
+std::pair<unsigned, Rect> QuadTree::BuildNode::findPartition(
+    Vec2 pos
+) const {
+    float x_m = bounds.x + bounds.width / 2.f;
+    float y_m = bounds.y + bounds.height / 2.f;
+    unsigned index = 0;
+    index  |= pos.x <= x_m ? left : right;
+    index  |= pos.y <= y_m ? top : bottom;
+    return {index, childBounds(index)};
 }
 
-Node::iterator::operator size_t() const {
-    return node.children[i];
+Rect QuadTree::BuildNode::childBounds(unsigned partition) const {
+    Rect rect;
+    rect.x = bounds.x;
+    rect.y = bounds.y;
+    rect.width = bounds.width / 2.f;
+    rect.height = bounds.height / 2.f;
+    rect.x += partition & right ? rect.width : 0.f;
+    rect.y += partition & bottom ? rect.height : 0.f;
+    return rect;
 }
 
 std::ostream& printIndent(std::ostream& o, size_t level) {
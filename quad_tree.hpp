@@ -4,75 +4,218 @@
 #include <array>
 #include <vector>
 #include <iostream>
+#include "arena.hpp"
+#include "body_store.hpp"
 #include "common.hpp"
 
 class QuadTree {
 public:
-    struct Node {
-        using Index = ssize_t;
-        static constexpr ssize_t const
-            top = 0b00
-        ,   bottom = 0b10
-        ,   left = 0b00
-        ,   right = 0b01
-        ;
+    using Index = uint32_t;
+    // no node, no body
+    static constexpr Index none = ~Index(0);
+    static constexpr unsigned const
+        top = 0b00
+    ,   bottom = 0b10
+    ,   left = 0b00
+    ,   right = 0b01
+    ;
+
+    // What the force walks read of a node, kept apart from the rest so a
+    // walk pulls in nothing it doesn't use.
+    struct Hot {
+        RealVec2 massCenter;
+        Real mass;
+        // width of the node's cell
+        float size;
+        // the node right after this one's subtree in depth-first order, a
+        // walk that doesn't open this node continues there
+        Index next;
+        // the bodies in this node's subtree are `bodies[first, first + count)`
+        Index first;
+        Index count;
+    };
+
+    struct Cold {
+        Rect bounds;
+        // The children are `firstChild`, which is right after the node, and
+        // then the `next` of each child in turn, one per bit of `childMask`
+        // in the order of the partitions.
+        Index firstChild;
+        uint8_t childMask;
+    };
+
+    // the children of a node, see `Cold::firstChild`
+    class ChildIterator {
+    public:
+        ChildIterator(QuadTree const& _tree, Index _child, unsigned _mask);
+        Index operator*() const;
+        // top/bottom | left/right of the child
+        unsigned partition() const;
+        ChildIterator& operator++();
+        bool operator!=(ChildIterator const& other) const;
+    private:
+        QuadTree const& tree;
+        Index child;
+        unsigned mask;
+    };
+    struct Children {
+        ChildIterator first;
+        ChildIterator last;
+        ChildIterator begin() const;
+        ChildIterator end() const;
+    };
+
+    enum class BuildMode {
+        // one body at a time by recursive descent from the root
+        incremental,
+        // sorts the bodies along a Z-order curve and emits the nodes in a
+        // single depth-first pass
+        morton,
+    };
+
+    enum class Update {
+        // every body is still inside its leaf, only the moments change
+        refitted,
+        // the bodies that left their leaf were inserted again from the root
+        reinserted,
+        // built from scratch
+        rebuilt,
+    };
+
+    // Leaves are only split this deep, bodies still sharing a leaf there sit
+    // on top of each other and the leaf goes over `leafCapacity`.
+    static constexpr unsigned maxDepth = 32;
+
+    // After `build` the nodes are in depth-first order, with the children of
+    // a node in the order of their partitions: the first child of a node is
+    // right after it, and a node is a leaf when `next` is right after it.
+    // Both halves of a node are at the same index.
+    Arena<Hot> hot;
+    Arena<Cold> cold;
+    // xx, xy, yy of sum(m * d * d^T) for the offsets d of the bodies from
+    // `massCenter`, only filled in with `Simulation::quadrupoles`
+    Arena<std::array<Real, 3>> quadrupoles;
+    // the bodies in depth-first order of their leaves
+    std::vector<Entity> bodies;
+    // Position and mass of `bodies[k]`, so the bodies of a node are
+    // contiguous for `directSum`. Filled in by the simulation along with the
+    // mass moments of the nodes.
+    AlignedVector<Real> bodyX;
+    AlignedVector<Real> bodyY;
+    AlignedVector<Real> bodyMasses;
+    BuildMode buildMode;
+    // bodies a leaf holds before it gets split
+    size_t leafCapacity;
+    // `update` builds from scratch once more than this fraction of the bodies
+    // left their leaf
+    float rebuildThreshold = 0.05f;
+
+    QuadTree(
+        Rect viewport,
+        BuildMode _buildMode = BuildMode::incremental,
+        size_t _leafCapacity = 1
+    );
+    void clear();
+    // the viewport the tree was made for, the root's cell
+    Rect const& bounds() const;
+    size_t nodeCount() const;
+    bool isLeaf(Index i) const;
+    Children children(Index i) const;
+    // levels below the root of the deepest node, from the smallest cell
+    unsigned depth() const;
+    // rebuilds the tree from scratch with `buildMode`
+    void build(BodyStore<Real> const& store);
+    // Brings the tree up to date with bodies that moved a bit since the last
+    // `build` or `update`. Bodies that are still inside their leaf stay put,
+    // the others are taken out and inserted again, and the tree is rebuilt
+    // when that would leave it too far from a fresh build. Builds from
+    // scratch when the bodies aren't the ones the tree was built for.
+    Update update(BodyStore<Real> const& store);
+    std::ostream& printNode(
+        Index i,
+        std::ostream& o,
+        size_t level = 0
+    ) const;
+
+private:
+    // A node while the tree is being built, with a link per partition so
+    // bodies can be inserted anywhere. `hot` and `cold` are laid out from
+    // these once the build is done.
+    struct BuildNode {
+        Rect bounds;
         // tl, tr, bl, br
         std::array<Index, 4> children;
-        Rectangle bounds;
-        Entity e;
-        float mass;
-        Vector2 massCenter;
-
-        class iterator {
-        public:
-            using difference_type = iterator;
-            using value_type = size_t;
-            using pointer = iterator const *;
-            using reference = iterator const &;
-            using iterator_tag = std::output_iterator_tag;
-
-            explicit iterator(Node const& _node, size_t _i);
-            iterator& operator++();
-            iterator operator++(int);
-            bool operator==(iterator const& other) const;
-            bool operator!=(iterator const& other) const;
-            reference operator*() const;
-            template <typename T> Node& getFrom(T& collection) const;
-            operator size_t() const;
-        private:
-            Node const& node;
-            size_t i;
-        };
-
-        Node(
-            Rectangle _bounds = {-1, -1, -1, -1},
-            Entity _e = -1,
-            std::array<Node::Index, 4> _children = {-1, -1, -1, -1}
-        );
-        bool hasChild(ssize_t i) const;
+        Index first;
+        Index count;
+
+        explicit BuildNode(Rect _bounds = {-1, -1, -1, -1});
+        bool hasChild(unsigned partition) const;
         bool hasChildren() const;
-        size_t countChildren() const;
-        bool hasEntity() const;
-        std::pair<ssize_t, Rectangle> findPartition(Vector2 pos) const;
-        iterator begin() const;
-        iterator end() const;
+        std::pair<unsigned, Rect> findPartition(Vec2 pos) const;
+        Rect childBounds(unsigned partition) const;
+    };
+    struct KeyedEntity {
+        uint64_t key;
+        Entity e;
+    };
+    struct Relocation {
+        Index from;
+        Index parent;
+        unsigned partition;
+    };
+    struct PendingNode {
+        Index parent;
+        unsigned partition;
+        size_t begin;
+        size_t end;
+        unsigned level;
     };
 
-    std::vector<Node> nodes;
+    Rect viewport;
+    // in depth-first order between builds, like `hot` and `cold`
+    Arena<BuildNode> building;
+    // kept around between builds so rebuilding doesn't allocate
+    Arena<BuildNode> reordered;
+    std::vector<KeyedEntity> keyed;
+    std::vector<KeyedEntity> keyedScratch;
+    std::vector<PendingNode> pending;
+    std::vector<Relocation> relocations;
+    // While the incremental build runs, the bodies of a leaf form a list
+    // starting at its `first`, linked through here.
+    std::vector<Index> leafLinks;
+    // the leaf every body is in
+    std::vector<Index> leafOf;
+    std::vector<Entity> moved;
+    // bodies below each node of `building`, for `pruneEmpty`
+    std::vector<Index> heldCounts;
 
-    QuadTree(Rectangle viewport);
-    void clear();
-    Node& root();
     void insert(
         Entity e,
-        std::vector<Vector2> const& positions,
-        Node::Index i = 0
+        BodyStore<Real> const& store,
+        Index i = 0,
+        unsigned depth = 0
     );
-    std::ostream& printNode(
-        QuadTree::Node::Index i,
-        std::ostream& o,
-        size_t level = 0
-    ) const;
+    void insertIntoChild(
+        Entity e,
+        BodyStore<Real> const& store,
+        Index i,
+        unsigned depth
+    );
+    void buildMorton(BodyStore<Real> const& store);
+    // unlinks the subtrees `update` left without bodies, `reorderDepthFirst`
+    // then drops them
+    void pruneEmpty();
+    // puts the nodes of the incremental build in depth-first order
+    void reorderDepthFirst();
+    // turns the leaf lists of the incremental build into ranges of `bodies`
+    void gatherLeafBodies();
+    // fills in the body range of the inner nodes and lays out `hot` and
+    // `cold`
+    void layOut();
+    void indexLeaves();
+    // whether the body would still end up in `leaf` when inserted from the
+    // root, where leaves on the edge of the root hold everything beyond it
+    bool holds(BuildNode const& leaf, Vec2 pos) const;
 };
 
 static inline std::ostream&
@@ -0,0 +1,21 @@
+#ifndef PARSIM_RAYLIB_BRIDGE_H
+#define PARSIM_RAYLIB_BRIDGE_H
+#include <raylib.h>
+
+#include "common.hpp"
+
+// Only included by the windowed build, the simulation core never sees raylib.
+
+static inline Vector2 toRaylib(Vec2 v) {
+    return {v.x, v.y};
+}
+
+static inline Rectangle toRaylib(Rect r) {
+    return {r.x, r.y, r.width, r.height};
+}
+
+static inline Color toRaylib(Rgba c) {
+    return {c.r, c.g, c.b, c.a};
+}
+
+#endif /* PARSIM_RAYLIB_BRIDGE_H */
\ No newline at end of file
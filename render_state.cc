@@ -0,0 +1,105 @@
+#include <algorithm>
+
+#include "render_state.hpp"
+#include "simulation.hpp"
+
+namespace {
+Rect unite(Rect a, Rect b) {
+    if (a.width < 0) {
+        return b;
+    }
+    if (b.width < 0) {
+        return a;
+    }
+    float const
+        left = std::min(a.x, b.x)
+    ,   top = std::min(a.y, b.y)
+    ,   right = std::max(a.x + a.width, b.x + b.width)
+    ,   bottom = std::max(a.y + a.height, b.y + b.height)
+    ;
+    return {left, top, right - left, bottom - top};
+}
+}
+
+void RenderState::capture(Simulation const& simulation, bool withTree) {
+    size_t const n = simulation.size();
+    BodyStore<Real> const& bodies = simulation.bodies;
+    positions.resize(n);
+    radii.resize(n);
+    for (Entity e = 0; (size_t)e < n; e++) {
+        positions[e] = vec2Cast<float>(bodies.position(e));
+        radii[e] = float(bodies.radii[e]);
+    }
+    colors.assign(simulation.colors.begin(), simulation.colors.end());
+    time = simulation.time;
+    profile = simulation.stats().last;
+
+    QuadTree const& tree = simulation.tree;
+    nodes.clear();
+    order.clear();
+    // bodies merged since the tree was built aren't in it any more
+    if (!withTree || tree.bodies.size() != n) {
+        return;
+    }
+    order.assign(tree.bodies.begin(), tree.bodies.end());
+    nodes.resize(tree.nodeCount());
+    // preorder, so the subtrees still open are the ones on the stack
+    std::vector<uint32_t> open;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        QuadTree::Hot const& from = tree.hot[i];
+        while (!open.empty() && open.back() <= i) {
+            open.pop_back();
+        }
+        Node& node = nodes[i];
+        node.bounds = tree.cold[i].bounds;
+        node.first = from.first;
+        node.count = from.count;
+        node.next = from.next;
+        node.depth = open.size();
+        open.push_back(from.next);
+    }
+    // bottom up, the children of a node all come after it
+    std::vector<float> colorSums(4 * nodes.size());
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& node = nodes[i];
+        float *colorSum = &colorSums[4 * i];
+        Rect extent = {0, 0, -1, -1};
+        Vec2 positionSum = {0, 0};
+        if (node.next == i + 1) {
+            for (uint32_t k = node.first; k < node.first + node.count; k++) {
+                uint32_t const e = order[k];
+                float const r = radii[e];
+                extent = unite(
+                    extent,
+                    {positions[e].x - r, positions[e].y - r, 2 * r, 2 * r}
+                );
+                positionSum.x += positions[e].x;
+                positionSum.y += positions[e].y;
+                Rgba const c = colors[e];
+                colorSum[0] += c.r;
+                colorSum[1] += c.g;
+                colorSum[2] += c.b;
+                colorSum[3] += c.a;
+            }
+        } else {
+            for (uint32_t const child : tree.children(i)) {
+                Node const& below = nodes[child];
+                extent = unite(extent, below.extent);
+                positionSum.x += below.centroid.x * below.count;
+                positionSum.y += below.centroid.y * below.count;
+                for (size_t c = 0; c < 4; c++) {
+                    colorSum[c] += colorSums[4 * child + c];
+                }
+            }
+        }
+        node.extent = extent;
+        float const count = std::max<uint32_t>(node.count, 1);
+        node.centroid = {positionSum.x / count, positionSum.y / count};
+        node.color = {
+            uint8_t(colorSum[0] / count),
+            uint8_t(colorSum[1] / count),
+            uint8_t(colorSum[2] / count),
+            uint8_t(colorSum[3] / count),
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef PARSIM_RENDER_STATE_H
+#define PARSIM_RENDER_STATE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "common.hpp"
+#include "profile.hpp"
+
+class Simulation;
+
+// What drawing needs of a simulation at one moment, copied out so the
+// render thread never reads the simulation while it's being stepped.
+struct RenderState {
+    // A quad tree node as culling sees it, in the depth-first order of
+    // `QuadTree::hot`.
+    struct Node {
+        // the quad tree cell, for the overlay
+        Rect bounds;
+        // box around the disks of the bodies below, where they are now
+        // rather than where they were when the tree was built
+        Rect extent;
+        // mean position and color of the bodies below
+        Vec2 centroid;
+        Rgba color;
+        // the bodies below are `order[first, first + count)`
+        uint32_t first;
+        uint32_t count;
+        // the node after this one's subtree
+        uint32_t next;
+        uint32_t depth;
+    };
+
+    std::vector<Vec2> positions;
+    std::vector<float> radii;
+    std::vector<Rgba> colors;
+    // empty unless the tree was captured, and when the tree doesn't hold
+    // every body
+    std::vector<Node> nodes;
+    // the bodies in the order of the tree's leaves
+    std::vector<uint32_t> order;
+    double time = 0.;
+    // updates done by the time it was captured
+    uint64_t updates = 0;
+    // of the last update, zero unless built with `PARSIM_PROFILE`
+    Profile profile;
+
+    // Overwrites the state with the simulation's, the columns keep their
+    // capacity from one capture to the next.
+    void capture(Simulation const& simulation, bool withTree);
+};
+
+// How the world is mapped onto the screen, owned by whoever draws.
+struct View {
+    // marked with a cross
+    Vec2 pointer;
+    // stays put when zooming
+    Vec2 referencePoint;
+    float scale = 1.f;
+
+    Vec2 toScreen(Vec2 world) const {
+        return {
+            referencePoint.x + (world.x - referencePoint.x) * scale,
+            referencePoint.y + (world.y - referencePoint.y) * scale,
+        };
+    }
+    Rect toScreen(Rect world) const {
+        Vec2 const corner = toScreen(Vec2 {world.x, world.y});
+        return {
+            corner.x,
+            corner.y,
+            world.width * scale,
+            world.height * scale,
+        };
+    }
+};
+
+#endif /* PARSIM_RENDER_STATE_H */
\ No newline at end of file
@@ -1,197 +1,550 @@
-#include "simulation.hpp"
+#include <algorithm>
+#include <cmath>
 
-static float calcGravity(float G, float m1, float m2, float r);
+#include "simulation.hpp"
+#include "barnes_hut.hpp"
+#include "profile.hpp"
 
 Simulation::Simulation(
     std::vector<MaterialInfo> materialsTable,
-    Rectangle viewport,
+    Rect viewport,
     float _theta,
-    Vector2 _pointer
+    Vec2 _pointer,
+    QuadTree::BuildMode buildMode
 )
-: tree(viewport)
+: tree(viewport, buildMode)
 , theta(_theta)
 , pointer(_pointer)
 , referencePoint(_pointer)
-, materialsTable(materialsTable) {}
+, materialsTable(materialsTable)
+, solver(std::make_unique<BarnesHutSolver>())
+, integrator(std::make_unique<LeapfrogIntegrator>()) {}
+
+Real Simulation::massOf(Real radius, size_t material) const {
+    Real const
+        area = Real(M_PI) * radius * radius
+    ,   density = materialsTable[material].density
+    ;
+    return area * density;
+}
 
 void Simulation::add(
-    Vector2 position,
-    Vector2 velocity,
-    float radius,
-    Color color,
+    RealVec2 position,
+    RealVec2 velocity,
+    Real radius,
+    Rgba color,
     size_t material
 ) {
-    positions.push_back(position);
-    velocities.push_back(velocity);
-    radii.push_back(radius);
+    bodies.add(position, velocity, radius, massOf(radius, material));
     colors.push_back(color);
     materials.push_back(material);
     forces.push_back({0, 0});
+    farForces.push_back({0, 0});
 }
 
 size_t Simulation::size() const {
-    return positions.size();
+    return bodies.size();
+}
+
+void Simulation::resize(size_t n) {
+    bodies.resize(n);
+    materials.resize(n);
+    colors.resize(n);
+    forces.resize(n);
+    farForces.resize(n);
+}
+
+size_t Simulation::threadCount() const {
+    return pool.size();
+}
+
+void Simulation::setThreadCount(size_t threads) {
+    pool.resize(threads);
+}
+
+void Simulation::setSolver(std::unique_ptr<GravitySolver> _solver) {
+    solver = std::move(_solver);
+}
+
+GravitySolver const& Simulation::gravitySolver() const {
+    return *solver;
+}
+
+void Simulation::setIntegrator(std::unique_ptr<Integrator> _integrator) {
+    integrator = std::move(_integrator);
+}
+
+Stats const& Simulation::stats() const {
+    return statistics;
+}
+
+void Simulation::resetStats() {
+    statistics = Stats();
 }
 
 void Simulation::update(float dt) {
-    for (float ddt = 0.f; ddt < dt; ddt += dt / 100.f) {
-        tree.clear();
+    PARSIM_COUNT(profile.clear());
+    {
+        PARSIM_TIME(profile, Phase::update);
+        time += dt;
+        if (blockTimesteps) {
+            updateBlocks(dt);
+        } else {
+            updateSubsteps(dt);
+        }
+    }
+    statistics.last = profile;
+    statistics.total.add(profile);
+    statistics.updates++;
+}
 
+void Simulation::updateSubsteps(float dt) {
+    // Bodies may have been added or moved, and `externalForce` changed,
+    // since the last update, so the forces the integrator starts from are
+    // computed anew.
+    integrator->start(*this);
+    size_t const steps = std::max(substeps, size_t(1));
+    for (size_t i = 0; i < steps; i++) {
+        PARSIM_TIME(profile, Phase::substep);
+        integrator->step(*this, dt / steps);
+        // The merged bodies carry the summed forces of their parts, but the
+        // solver may still hold the old numbering, so the integrator starts
+        // over.
+        if (resolveCollisions()) {
+            integrator->start(*this);
+        }
+    }
+}
+
+// Block steps: the frame is split into 2^maxTimestepLevel ticks and a body
+// on level l steps every 2^(maxTimestepLevel - l) ticks as kick-drift-kick,
+// so all bodies line up again at the end of the frame. Every body's position
+// is brought up to date on every tick since the tree needs it, but the field
+// is only computed for the bodies that close a step. Positions are drifted
+// from where the step started rather than tick by tick, which in float would
+// lose most of each tiny increment to rounding.
+void Simulation::updateBlocks(float dt) {
+    size_t const n = size();
+    if (
+        timestepLevels.size() != n
+    ||  accelerations.size() != n
+    ) {
+        startBlocks();
+    }
+    unsigned const maxLevel = maxTimestepLevel;
+    uint32_t const ticks = uint32_t(1) << maxLevel;
+    Real const tick = Real(dt) / ticks;
+    auto const stepTicks = [&](unsigned level) {
+        return uint32_t(1) << (maxLevel - level);
+    };
+    for (unsigned& level : timestepLevels) {
+        level = std::min(level, maxLevel);
+    }
+
+    for (uint32_t t = 0; t < ticks; t++) {
+        PARSIM_TIME(profile, Phase::substep);
+        for (Entity e = 0; (size_t)e < n; e++) {
+            uint32_t const step = stepTicks(timestepLevels[e]);
+            uint32_t const elapsed = t % step + 1;
+            if (elapsed == 1) {
+                bodies.setVelocity(
+                    e,
+                    bodies.velocity(e) + accelerations[e] * (step * tick / 2)
+                );
+                stepOrigins[e] = bodies.position(e);
+            }
+            bodies.setPosition(
+                e,
+                stepOrigins[e] + bodies.velocity(e) * (elapsed * tick)
+            );
+        }
+
+        active.clear();
+        for (Entity e = 0; (size_t)e < n; e++) {
+            if ((t + 1) % stepTicks(timestepLevels[e]) == 0) {
+                active.push_back(e);
+            }
+        }
+        if (active.empty()) {
+            continue;
+        }
         buildQuadTree();
+        computeNodeMasses();
+        fields.resize(n);
+        {
+            PARSIM_TIME(profile, Phase::forces);
+            solver->computeFieldFor(*this, active, fields, pool);
+        }
+        PARSIM_COUNT(profile.addInteractions(solver->interactions()));
 
-        calculateForceVectors();
-
-        applyForces(ddt);
-    }
-}
-
-void Simulation::draw() const {
-    for (auto const& node : tree.nodes) {
-        Rectangle bounds = node.bounds;
-        Vector2 renderPosition = {bounds.x, bounds.y};
-        renderPosition =
-            referencePoint + (renderPosition - referencePoint) * scale;
-        DrawRectangleLines(
-            renderPosition.x,
-            renderPosition.y,
-            bounds.width * scale,
-            bounds.height * scale,
-            LIME
-        );
-    }
-    auto position = positions.begin();
-    auto radius = radii.begin();
-    auto color = colors.begin();
-    for (; position != positions.end(); position++, radius++, color++) {
-        Vector2 renderPosition = *position;
-        renderPosition =
-            referencePoint + (renderPosition - referencePoint) * scale;
-        DrawPoly(renderPosition, 30, *radius * scale, 0, *color);
-        // DrawCircleV(*position, *radius, *color);
-    }
-
-    DrawRectangle(
-        pointer.x - 10.f,
-        pointer.y - 2.5f,
-        20.f,
-        5.f,
-        GOLD
-    );
-    DrawRectangle(
-        pointer.x - 2.5f,
-        pointer.y - 10.f,
-        5.f,
-        20.f,
-        GOLD
-    );
+        for (Entity e : active) {
+            unsigned& level = timestepLevels[e];
+            Real const stepTime = stepTicks(level) * tick;
+            forces[e] = forceOn(e, fields[e]);
+            if (e == 0) {
+                forces[e] += externalForce;
+            }
+            RealVec2 const acceleration = forces[e] / bodies.masses[e];
+            bodies.setVelocity(
+                e,
+                bodies.velocity(e) + acceleration * (stepTime / 2)
+            );
+
+            Real const
+                jerk = abs(acceleration - accelerations[e]) / stepTime
+            ,   wanted = jerk > 0
+                    ? timestepAccuracy * abs(acceleration) / jerk
+                    : dt
+            ;
+            accelerations[e] = acceleration;
+            unsigned const fit = (unsigned)std::clamp<Real>(
+                std::ceil(std::log2(dt / wanted)),
+                0,
+                maxLevel
+            );
+            // Going finer is always in sync, going coarser only where the
+            // coarser step would have ended too, one level at a time.
+            if (fit > level) {
+                level = fit;
+            } else if (
+                fit < level
+            &&  (t + 1) % stepTicks(level - 1) == 0
+            ) {
+                level--;
+            }
+        }
+    }
+    // every body is in sync here, a merge changes the body count and the
+    // next frame starts the blocks over
+    resolveCollisions();
 }
 
-void Simulation::buildQuadTree() {
-    for (Entity e = 0; (size_t)e < size(); e++) {
-        tree.insert(e, positions);
+void Simulation::startBlocks() {
+    computeForces();
+    size_t const n = size();
+    accelerations.resize(n);
+    stepOrigins.resize(n);
+    timestepLevels.assign(n, maxTimestepLevel);
+    for (Entity e = 0; (size_t)e < n; e++) {
+        accelerations[e] = forces[e] / bodies.masses[e];
+        stepOrigins[e] = bodies.position(e);
     }
 }
 
-void Simulation::calculateForceVectors() {
-    for (Entity e = 0; (size_t)e < size(); e++) {
-        forces[e] = calculateForceFor(e);
+void Simulation::computeForces() {
+    buildQuadTree();
+
+    computeNodeMasses();
+
+    calculateForceVectors();
+}
+
+void Simulation::computeForcesFor(std::vector<Entity> const& targets) {
+    buildQuadTree();
+    computeNodeMasses();
+    PARSIM_TIME(profile, Phase::forces);
+    fields.resize(size());
+    solver->computeFieldFor(*this, targets, fields, pool);
+    PARSIM_COUNT(profile.addInteractions(solver->interactions()));
+    for (Entity e : targets) {
+        forces[e] = forceOn(e, fields[e]);
         if (e == 0) {
             forces[e] += externalForce;
         }
     }
 }
 
-void Simulation::applyForces(float dt) {
+void Simulation::buildTree() {
+    buildQuadTree();
+    computeNodeMasses();
+}
+
+void Simulation::buildQuadTree() {
+    PARSIM_TIME(profile, Phase::buildTree);
+    [[maybe_unused]] QuadTree::Update change = QuadTree::Update::rebuilt;
+    if (refitTree) {
+        change = tree.update(bodies);
+    } else {
+        tree.build(bodies);
+    }
+    PARSIM_COUNT(
+        if (change != QuadTree::Update::refitted) {
+            profile.nodesCreated += tree.nodeCount();
+            profile.treeDepth = std::max<uint64_t>(
+                profile.treeDepth,
+                tree.depth()
+            );
+        }
+    );
+}
+
+void Simulation::computeNodeMasses() {
+    PARSIM_TIME(profile, Phase::nodeMasses);
+    size_t const n = tree.bodies.size();
+    tree.bodyX.resize(n);
+    tree.bodyY.resize(n);
+    tree.bodyMasses.resize(n);
+    for (size_t k = 0; k < n; k++) {
+        Entity const e = tree.bodies[k];
+        tree.bodyX[k] = bodies.x[e];
+        tree.bodyY[k] = bodies.y[e];
+        tree.bodyMasses[k] = bodies.masses[e];
+    }
+
+    // Children are always laid out after their parent, so walking the nodes
+    // backwards every child is done before the node that sums it up.
+    for (size_t i = tree.nodeCount(); i-- > 0;) {
+        QuadTree::Hot& node = tree.hot[i];
+        if (tree.isLeaf(i)) {
+            Real mass = 0;
+            RealVec2 moment = {0, 0};
+            for (auto k = node.first; k < node.first + node.count; k++) {
+                mass += tree.bodyMasses[k];
+                moment += RealVec2 {tree.bodyX[k], tree.bodyY[k]}
+                    * tree.bodyMasses[k];
+            }
+            node.mass = mass;
+            node.massCenter = mass > 0 ? moment / mass : moment;
+            if (!quadrupoles) {
+                continue;
+            }
+            std::array<Real, 3> q = {0, 0, 0};
+            for (auto k = node.first; k < node.first + node.count; k++) {
+                Real const
+                    dx = tree.bodyX[k] - node.massCenter.x
+                ,   dy = tree.bodyY[k] - node.massCenter.y
+                ,   m = tree.bodyMasses[k]
+                ;
+                q[0] += m * dx * dx;
+                q[1] += m * dx * dy;
+                q[2] += m * dy * dy;
+            }
+            tree.quadrupoles[i] = q;
+            continue;
+        }
+        Real mass = 0;
+        RealVec2 moment = {0, 0};
+        for (auto const c : tree.children(i)) {
+            QuadTree::Hot const& child = tree.hot[c];
+            mass += child.mass;
+            moment += child.massCenter * child.mass;
+        }
+        node.mass = mass;
+        node.massCenter = mass > 0 ? moment / mass : moment;
+        if (!quadrupoles) {
+            continue;
+        }
+        // parallel axis theorem, moving each child's moment to this center
+        std::array<Real, 3> q = {0, 0, 0};
+        for (auto const c : tree.children(i)) {
+            QuadTree::Hot const& child = tree.hot[c];
+            std::array<Real, 3> const& childQ = tree.quadrupoles[c];
+            Real const
+                dx = child.massCenter.x - node.massCenter.x
+            ,   dy = child.massCenter.y - node.massCenter.y
+            ;
+            q[0] += childQ[0] + child.mass * dx * dx;
+            q[1] += childQ[1] + child.mass * dx * dy;
+            q[2] += childQ[2] + child.mass * dy * dy;
+        }
+        tree.quadrupoles[i] = q;
+    }
+}
+
+void Simulation::calculateForceVectors() {
+    PARSIM_TIME(profile, Phase::forces);
+    fields.resize(size());
+    solver->computeField(*this, fields, pool);
+    PARSIM_COUNT(profile.addInteractions(solver->interactions()));
     for (Entity e = 0; (size_t)e < size(); e++) {
-        Vector2 const force = forces[e];
-        Vector2
-            &position = positions[e]
-        ,   &velocity = velocities[e]
-        ;
-        float const
-            r       = radii[e]
-        ,   area    = M_PIf * r * r
-        ,   density = materialsTable[materials[e]].density
-        ,   mass    = area * density
-        ;
+        forces[e] = forceOn(e, fields[e]);
+    }
+    if (size() > 0) {
+        forces[0] += externalForce;
+    }
+}
+
+void Simulation::computeSplitForces() {
+    buildQuadTree();
+    computeNodeMasses();
+    PARSIM_TIME(profile, Phase::forces);
+    fields.resize(size());
+    farFields.resize(size());
+    solver->computeSplitField(*this, farFields, fields, pool);
+    PARSIM_COUNT(profile.addInteractions(solver->interactions()));
+    for (Entity e = 0; (size_t)e < size(); e++) {
+        forces[e] = forceOn(e, fields[e]);
+        farForces[e] = forceOn(e, farFields[e]);
+    }
+    if (size() > 0) {
+        forces[0] += externalForce;
+    }
+}
+
+void Simulation::computeNearForces() {
+    if (solver->nearFieldNeedsTree()) {
+        buildQuadTree();
+        computeNodeMasses();
+    }
+    PARSIM_TIME(profile, Phase::forces);
+    fields.resize(size());
+    solver->computeNearField(*this, fields, pool);
+    PARSIM_COUNT(profile.addInteractions(solver->interactions()));
+    for (Entity e = 0; (size_t)e < size(); e++) {
+        forces[e] = forceOn(e, fields[e]);
+    }
+    if (size() > 0) {
+        forces[0] += externalForce;
+    }
+}
+
+RealVec2 Simulation::forceOn(Entity e, RealVec2 field) const {
+    return field * bodies.masses[e];
+}
+
+void Simulation::kick(float dt) {
+    PARSIM_TIME(profile, Phase::kick);
+    Real *vx = bodies.vx.data(), *vy = bodies.vy.data();
+    Real const *m = bodies.masses.data();
+    for (size_t e = 0; e < size(); e++) {
         // F = ma
-        Vector2 acceleration = force / mass;
-        position += velocity * dt;
-        velocity += acceleration * dt;
-    }
-}
-
-std::pair<float, Vector2> Simulation::getNodeMassInfo(QuadTree::Node::Index i) {
-    QuadTree::Node& node = tree.nodes.at(i);
-    float mass = 0.f;
-    Vector2 center = {0.f, 0.f};
-    if (node.mass == -1 && !node.hasChildren()) {
-        float r = radii[node.e];
-        float area = M_PIf * r * r;
-        node.mass = area * materialsTable[materials[node.e]].density;
-        node.massCenter = positions[node.e];
-    }
-    if (node.mass != -1) {
-        mass = node.mass;
-        center = node.massCenter;
-    } else if (node.hasChildren()) {
-        for (auto const childDesc : node) {
-            auto const childMassInfo = getNodeMassInfo(childDesc);
-            mass += std::get<0>(childMassInfo);
-            center =
-                std::get<1>(childMassInfo) * std::get<0>(childMassInfo)
-                + center;
-        }
-        center = center / mass;
-        node.mass = mass;
-        node.massCenter = center;
+        Real const scale = Real(dt) / m[e];
+        vx[e] += forces[e].x * scale;
+        vy[e] += forces[e].y * scale;
     }
-    return {mass, center};
 }
 
-Vector2 Simulation::calculateForceFor(Entity e, QuadTree::Node::Index i) {
-    Vector2 force = {0.f, 0.f};
-    QuadTree::Node& node = tree.nodes.at(i);
-    if (node.e == e) {
-        return {0.f, 0.f};
+void Simulation::kickFar(float dt) {
+    PARSIM_TIME(profile, Phase::kick);
+    Real *vx = bodies.vx.data(), *vy = bodies.vy.data();
+    Real const *m = bodies.masses.data();
+    for (size_t e = 0; e < size(); e++) {
+        Real const scale = Real(dt) / m[e];
+        vx[e] += farForces[e].x * scale;
+        vy[e] += farForces[e].y * scale;
     }
-    Vector2 position = positions[e];
+}
 
-    float const entityRadius = radii[e];
-    // float const entityArea = entityRadius * entityRadius * M_PIf;
-    // assume sphere
-    float const
-        entityVolume =
-            4.f * M_PIf * entityRadius / 3.f * entityRadius * entityRadius
-    ,   entityMass =
-            entityVolume * materialsTable[materials[e]].density;
+void Simulation::drift(float dt) {
+    PARSIM_TIME(profile, Phase::drift);
+    Real *x = bodies.x.data(), *y = bodies.y.data();
+    Real const *vx = bodies.vx.data(), *vy = bodies.vy.data();
+    for (size_t e = 0; e < size(); e++) {
+        x[e] += vx[e] * Real(dt);
+        y[e] += vy[e] * Real(dt);
+    }
+}
 
-    auto const massInfo = getNodeMassInfo(i);
-    float const
-        regionWidth = node.bounds.width
-    ,   dist = abs(std::get<1>(massInfo) - position)
-    ;
+bool Simulation::resolveCollisions() {
+    if (collisions == Collisions::ignore) {
+        return false;
+    }
+    PARSIM_TIME(profile, Phase::collisions);
+    auto const& pairs = collisionFinder.find(*this, pool);
+    if (pairs.empty()) {
+        return false;
+    }
+    if (collisions == Collisions::bounce) {
+        bounce(pairs);
+        return false;
+    }
+    merge(pairs);
+    return true;
+}
 
-    if (regionWidth / dist < theta || !node.hasChildren()) {
-        float const
-            distX = std::get<1>(massInfo).x - position.x
-        ,   distY = std::get<1>(massInfo).y - position.y
-        ,   distCos = distX / dist
-        ,   distSin = distY / dist
-        ,   forceModulo =
-                calcGravity(gamma, entityMass, std::get<0>(massInfo), dist)
-        ;
-        force.y = forceModulo * distSin;
-        force.x = forceModulo * distCos;
-    } else {
-        for (auto const childDesc : node) {
-            force = force + calculateForceFor(e, childDesc);
+void Simulation::bounce(std::vector<CollisionFinder::Pair> const& pairs) {
+    for (auto const [a, b] : pairs) {
+        RealVec2 const offset = bodies.position(b) - bodies.position(a);
+        Real const distance = abs(offset);
+        if (distance == 0) {
+            continue;
+        }
+        RealVec2 const normal = offset / distance;
+        RealVec2 const relative = bodies.velocity(b) - bodies.velocity(a);
+        Real const approach = relative.x * normal.x + relative.y * normal.y;
+        // already moving apart
+        if (approach >= 0) {
+            continue;
         }
+        Real const
+            ma = bodies.masses[a]
+        ,   mb = bodies.masses[b]
+        ,   impulse = 2 * approach / (ma + mb)
+        ;
+        bodies.setVelocity(a, bodies.velocity(a) + normal * (impulse * mb));
+        bodies.setVelocity(b, bodies.velocity(b) - normal * (impulse * ma));
     }
-    return force;
 }
 
-static float calcGravity(float G, float m1, float m2, float r) {
-    // return G * m1 * m2 / (r * r);
-    return G * m1 / r * m2 / r;
+// Overlaps chain, so the pairs are joined with a union-find first and every
+// group is merged into its smallest entity. That keeps body 0, which
+// `externalForce` acts on, in place.
+void Simulation::merge(std::vector<CollisionFinder::Pair> const& pairs) {
+    size_t const n = size();
+    std::vector<Entity> roots(n);
+    for (Entity e = 0; (size_t)e < n; e++) {
+        roots[e] = e;
+    }
+    auto const rootOf = [&](Entity e) {
+        while (roots[e] != e) {
+            roots[e] = roots[roots[e]];
+            e = roots[e];
+        }
+        return e;
+    };
+    for (auto const [a, b] : pairs) {
+        Entity const
+            ra = rootOf(a)
+        ,   rb = rootOf(b)
+        ;
+        roots[std::max(ra, rb)] = std::min(ra, rb);
+    }
+
+    // A root comes before every body of its group, so walking up the
+    // entities its sums are started before anything is added to them.
+    std::vector<char> dead(n, false), merged(n, false);
+    std::vector<Real> mass(n);
+    std::vector<RealVec2> moment(n), momentum(n);
+    std::vector<Entity> heaviest(n);
+    for (Entity e = 0; (size_t)e < n; e++) {
+        Entity const root = rootOf(e);
+        Real const m = bodies.masses[e];
+        if (root == e) {
+            mass[e] = m;
+            moment[e] = bodies.position(e) * m;
+            momentum[e] = bodies.velocity(e) * m;
+            heaviest[e] = e;
+            continue;
+        }
+        dead[e] = true;
+        merged[root] = true;
+        mass[root] += m;
+        moment[root] += bodies.position(e) * m;
+        momentum[root] += bodies.velocity(e) * m;
+        // the parts' forces sum up to the force on the whole, the forces
+        // between them cancel out
+        forces[root] += forces[e];
+        farForces[root] += farForces[e];
+        if (m > bodies.masses[heaviest[root]]) {
+            heaviest[root] = e;
+        }
+    }
+    for (Entity e = 0; (size_t)e < n; e++) {
+        if (!merged[e]) {
+            continue;
+        }
+        materials[e] = materials[heaviest[e]];
+        colors[e] = colors[heaviest[e]];
+        Real const density = materialsTable[materials[e]].density;
+        bodies.masses[e] = mass[e];
+        bodies.radii[e] = std::sqrt(mass[e] / (Real(M_PI) * density));
+        bodies.setPosition(e, moment[e] / mass[e]);
+        bodies.setVelocity(e, momentum[e] / mass[e]);
+    }
+
+    bodies.compact(dead);
+    compactColumn(materials, dead);
+    compactColumn(colors, dead);
+    compactColumn(forces, dead);
+    compactColumn(farForces, dead);
 }
\ No newline at end of file
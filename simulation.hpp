@@ -1,12 +1,19 @@
 #ifndef PARSIM_SIMULATION_H
 #define PARSIM_SIMULATION_H
 
+#include <memory>
 #include <vector>
 #include <string>
 
+#include "body_store.hpp"
+#include "collisions.hpp"
 #include "common.hpp"
 #include "util.hpp"
+#include "gravity_solver.hpp"
+#include "integrator.hpp"
+#include "profile.hpp"
 #include "quad_tree.hpp"
+#include "thread_pool.hpp"
 
 struct MaterialInfo {
     std::string name;
@@ -15,47 +22,149 @@ struct MaterialInfo {
 
 class Simulation {
 public:
-    std::vector<Vector2> positions;
-    std::vector<float>   radii;
-    std::vector<Vector2> velocities;
-    std::vector<size_t>  materials;
-    std::vector<Color>   colors;
-    std::vector<Vector2> forces;
+    enum class Collisions {
+        // bodies pass through each other
+        ignore,
+        // overlapping bodies that approach each other bounce off elastically
+        bounce,
+        // overlapping bodies become one, keeping mass, momentum and center
+        // of mass, with the material and color of the heaviest
+        merge,
+    };
+
+    // positions, velocities, radii and masses
+    BodyStore<Real>         bodies;
+    std::vector<size_t>     materials;
+    std::vector<Rgba>       colors;
+    std::vector<RealVec2>   forces;
+    // the far part of the force with `computeSplitForces`, when `forces` only
+    // holds the near part
+    std::vector<RealVec2>   farForces;
 
     QuadTree tree;
+    // simulated seconds, advanced by `update`
+    double time = 0.;
     float theta;
-    Vector2 pointer;
-    Vector2 referencePoint = pointer;
+    // the view a front end starts from, see `View`, the simulation itself
+    // doesn't use them
+    Vec2 pointer;
+    Vec2 referencePoint = pointer;
     float gamma = 6.674e-10;
     float scale = 1.f;
-    Vector2 externalForce = {0.f, 0.f};
+    RealVec2 externalForce = {0, 0};
 
     std::vector<MaterialInfo> materialsTable;
+    // bodies handed to a thread at a time during the force phase
+    size_t forceChunkSize = 64;
+    // Adds the quadrupole moment of accepted nodes to the Barnes-Hut field.
+    // Costs a bit more per interaction, but a larger `theta` reaches the
+    // same error.
+    bool quadrupoles = false;
+    // Keeps the tree between substeps and only moves the bodies that left
+    // their leaf, see `QuadTree::update`
+    bool refitTree = false;
+    // integrator steps per `update`
+    size_t substeps = 10;
+    // checked after every integrator step, or every frame with
+    // `blockTimesteps`
+    Collisions collisions = Collisions::ignore;
+    // Gives every body its own power-of-two fraction of the frame, down to
+    // `dt / 2^maxTimestepLevel`, picked from its acceleration and jerk. Only
+    // the bodies whose step ends on a tick get their field recomputed and
+    // their velocity kicked. Always kick-drift-kick, the integrator and
+    // `substeps` are ignored.
+    bool blockTimesteps = false;
+    unsigned maxTimestepLevel = 7;
+    // η in `dt_i = η |a| / |da/dt|`
+    float timestepAccuracy = 0.05f;
 
     Simulation(
         std::vector<MaterialInfo> materialsTable,
-        Rectangle viewport,
+        Rect viewport,
         float _theta,
-        Vector2 _pointer = {0.f, 0.f}
+        Vec2 _pointer = {0.f, 0.f},
+        QuadTree::BuildMode buildMode = QuadTree::BuildMode::incremental
     );
+    // the area of the body's disk times its material's density
+    Real massOf(Real radius, size_t material) const;
+    // the mass is worked out with `massOf`
     void add(
-        Vector2 position,
-        Vector2 velocity,
-        float radius,
-        Color color,
+        RealVec2 position,
+        RealVec2 velocity,
+        Real radius,
+        Rgba color,
         size_t material
     );
     size_t size() const;
+    // Grows or shrinks every per-body column to `n` bodies, new ones zeroed,
+    // for loaders that fill the columns in directly.
+    void resize(size_t n);
+    size_t threadCount() const;
+    void setThreadCount(size_t threads);
+    // Barnes-Hut unless set otherwise
+    void setSolver(std::unique_ptr<GravitySolver> _solver);
+    GravitySolver const& gravitySolver() const;
+    // leapfrog unless set otherwise
+    void setIntegrator(std::unique_ptr<Integrator> _integrator);
     void update(float dt);
-    void draw() const;
+    // Time per phase and tree counters of the last update and since the
+    // last reset. Only the update count is kept unless built with
+    // `PARSIM_PROFILE`.
+    Stats const& stats() const;
+    void resetStats();
+    // builds the tree and fills in `forces` without moving anything
+    void computeForces();
+    // like `computeForces`, but only the forces of `targets` are filled in,
+    // the other bodies only pull
+    void computeForcesFor(std::vector<Entity> const& targets);
+    // builds the tree and its mass moments for the bodies where they are
+    void buildTree();
+    // builds the tree and fills in `forces` with the near part of the force
+    // and `farForces` with the far part, see `GravitySolver`
+    void computeSplitForces();
+    // recomputes only `forces`, the near part
+    void computeNearForces();
+    // the building blocks of an `Integrator`
+    // velocities += forces / mass * dt
+    void kick(float dt);
+    // velocities += farForces / mass * dt
+    void kickFar(float dt);
+    // positions += velocities * dt
+    void drift(float dt);
 
 private:
+    ThreadPool pool;
+    std::unique_ptr<GravitySolver> solver;
+    std::unique_ptr<Integrator> integrator;
+    std::vector<RealVec2> fields;
+    std::vector<RealVec2> farFields;
+    // block timestep state, per body
+    std::vector<unsigned> timestepLevels;
+    std::vector<RealVec2> accelerations;
+    // where each body's current step started
+    std::vector<RealVec2> stepOrigins;
+    std::vector<Entity> active;
+    CollisionFinder collisionFinder;
+    Stats statistics;
+    // of the update in progress
+    Profile profile;
+
+    // `substeps` integrator steps
+    void updateSubsteps(float dt);
+    void updateBlocks(float dt);
+    // puts every body on the finest level with a fresh acceleration
+    void startBlocks();
     void buildQuadTree();
+    // fills in the body columns of the tree and `mass` and `massCenter` of
+    // every node, bottom up
+    void computeNodeMasses();
     void calculateForceVectors();
-    void applyForces(float dt);
-    //       [ mass, center ]
-    std::pair<float, Vector2> getNodeMassInfo(QuadTree::Node::Index i);
-    Vector2 calculateForceFor(Entity e, QuadTree::Node::Index i = 0);
+    // returns whether bodies were merged, which renumbers them
+    bool resolveCollisions();
+    void bounce(std::vector<CollisionFinder::Pair> const& pairs);
+    void merge(std::vector<CollisionFinder::Pair> const& pairs);
+    // the force a field puts on body `e`
+    RealVec2 forceOn(Entity e, RealVec2 field) const;
 };
 
 #endif /* PARSIM_SIMULATION_H */
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <algorithm>
+
+#include "draw_list.hpp"
+#include "raylib_bridge.hpp"
+
+// Raylib queues shapes into one vertex batch and only sends it to the GPU
+// when it's full or the kind of primitive changes, so drawing the lines,
+// the quads and the triangles each in one go costs a handful of draw calls
+// however long the list is.
+void draw(DrawList const& list, View const& view) {
+    for (Rect const& outline : list.outlines) {
+        DrawRectangleLines(
+            outline.x,
+            outline.y,
+            outline.width,
+            outline.height,
+            LIME
+        );
+    }
+    for (DrawList::Splat const& splat : list.splats) {
+        float const half = splat.size / 2;
+        DrawRectangleV(
+            {splat.center.x - half, splat.center.y - half},
+            {splat.size, splat.size},
+            toRaylib(splat.color)
+        );
+    }
+    for (DrawList::Disk const& disk : list.disks) {
+        // about one side per 2 pixels of circumference
+        int const sides = std::clamp(int(3.f * disk.radius), 6, 30);
+        DrawPoly(
+            toRaylib(disk.center),
+            sides,
+            disk.radius,
+            0,
+            toRaylib(disk.color)
+        );
+    }
+
+    DrawRectangle(
+        view.pointer.x - 10.f,
+        view.pointer.y - 2.5f,
+        20.f,
+        5.f,
+        GOLD
+    );
+    DrawRectangle(
+        view.pointer.x - 2.5f,
+        view.pointer.y - 10.f,
+        5.f,
+        20.f,
+        GOLD
+    );
+}
\ No newline at end of file
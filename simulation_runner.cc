@@ -0,0 +1,66 @@
+#include <chrono>
+
+#include "simulation_runner.hpp"
+
+SimulationRunner::SimulationRunner(
+    Simulation& _simulation,
+    Controls const& _controls
+)
+: simulation(_simulation)
+, controls(_controls) {
+    // so there's something to draw before the first update is done
+    states.back().capture(simulation, controls.captureTree);
+    states.publish();
+    thread = std::thread(&SimulationRunner::run, this);
+}
+
+SimulationRunner::~SimulationRunner() {
+    stopping = true;
+    thread.join();
+}
+
+void SimulationRunner::setControls(Controls const& _controls) {
+    std::lock_guard<std::mutex> lock(controlsMutex);
+    controls = _controls;
+}
+
+RenderState const& SimulationRunner::latest() {
+    states.update();
+    return states.front();
+}
+
+void SimulationRunner::run() {
+    using Clock = std::chrono::steady_clock;
+    // when the next update is due
+    Clock::time_point slot = Clock::now();
+    for (uint64_t updates = 1; !stopping; updates++) {
+        Controls current;
+        {
+            std::lock_guard<std::mutex> lock(controlsMutex);
+            current = controls;
+        }
+        if (current.updatesPerSecond > 0.f) {
+            auto const period = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<float>(1.f / current.updatesPerSecond)
+            );
+            Clock::time_point const now = Clock::now();
+            if (now < slot) {
+                std::this_thread::sleep_until(slot);
+                slot += period;
+            } else {
+                // behind, the missed slots are dropped
+                slot = now + period;
+            }
+        }
+        simulation.externalForce = current.externalForce;
+        if (current.stopFirstBody && simulation.size() > 0) {
+            simulation.bodies.setVelocity(0, {0, 0});
+        }
+        simulation.update(current.dt);
+
+        RenderState& state = states.back();
+        state.capture(simulation, current.captureTree);
+        state.updates = updates;
+        states.publish();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef PARSIM_SIMULATION_RUNNER_H
+#define PARSIM_SIMULATION_RUNNER_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "simulation.hpp"
+#include "render_state.hpp"
+#include "triple_buffer.hpp"
+
+// Steps a simulation on a thread of its own, `updatesPerSecond` updates of
+// `dt` per second of wall time, and publishes a `RenderState` after every
+// update through a triple buffer. The render thread draws the newest
+// finished state at its own pace and neither waits on the other. The
+// simulation mustn't be touched from elsewhere while the runner lives,
+// everything goes through `setControls`.
+class SimulationRunner {
+public:
+    // read once per update
+    struct Controls {
+        float dt = 1.f / 4.f;
+        // Wall time pacing, one update per frame of a 60 FPS window as
+        // before the runner. Updates that can't keep up are dropped rather
+        // than caught up on, 0 runs as fast as it goes.
+        float updatesPerSecond = 60.f;
+        RealVec2 externalForce = {0, 0};
+        // zeroes the velocity of the first body
+        bool stopFirstBody = false;
+        // fills in `RenderState::nodes` and `RenderState::order`
+        bool captureTree = true;
+    };
+
+    SimulationRunner(Simulation& simulation, Controls const& controls);
+    SimulationRunner(SimulationRunner const&) = delete;
+    SimulationRunner& operator=(SimulationRunner const&) = delete;
+    // finishes the update in progress
+    ~SimulationRunner();
+
+    void setControls(Controls const& controls);
+    // The newest published state, valid until the next call. Only call
+    // from one thread.
+    RenderState const& latest();
+
+private:
+    Simulation& simulation;
+    TripleBuffer<RenderState> states;
+    std::mutex controlsMutex;
+    Controls controls;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+    void run();
+};
+
+#endif /* PARSIM_SIMULATION_RUNNER_H */
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "snapshot.hpp"
+#include "mapped_file.hpp"
+
+static_assert(sizeof(Rgba) == 4, "colors are written as 4 bytes");
+
+namespace {
+using Column = Snapshot::Column;
+
+uint64_t alignUp(uint64_t offset) {
+    uint64_t const a = Snapshot::columnAlignment;
+    return (offset + a - 1) / a * a;
+}
+
+uint64_t elementSize(Column column, uint32_t scalarSize) {
+    switch (column) {
+    case Column::materials:
+        return sizeof(uint32_t);
+    case Column::colors:
+        return sizeof(Rgba);
+    default:
+        return scalarSize;
+    }
+}
+
+// fills in the column offsets and returns the size of the whole file
+uint64_t layOut(Snapshot::Header& header) {
+    uint64_t offset = alignUp(sizeof(Snapshot::Header));
+    for (size_t c = 0; c < size_t(Column::count); c++) {
+        header.columnOffsets[c] = offset;
+        offset = alignUp(
+            offset
+            + header.bodyCount * elementSize(Column(c), header.scalarSize)
+        );
+    }
+    return offset;
+}
+
+void writeColumn(std::ofstream& out, void const *data, uint64_t bytes) {
+    static char const padding[Snapshot::columnAlignment] = {};
+    out.write(static_cast<char const *>(data), bytes);
+    out.write(padding, alignUp(bytes) - bytes);
+}
+
+template <typename Stored>
+void readScalars(
+    unsigned char const *from,
+    size_t n,
+    AlignedVector<Real>& to
+) {
+    to.resize(n);
+    if constexpr (std::is_same_v<Stored, Real>) {
+        std::memcpy(to.data(), from, n * sizeof(Real));
+    } else {
+        std::vector<Stored> stored(n);
+        std::memcpy(stored.data(), from, n * sizeof(Stored));
+        std::copy(stored.begin(), stored.end(), to.begin());
+    }
+}
+}
+
+Snapshot::Status Snapshot::write(
+    Simulation const& simulation,
+    char const *path
+) {
+    Header header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.byteOrderMark = byteOrderMark;
+    header.scalarSize = sizeof(Real);
+    header.bodyCount = simulation.size();
+    header.time = simulation.time;
+    header.theta = simulation.theta;
+    header.gamma = simulation.gamma;
+    layOut(header);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return Status::cannotOpen;
+    }
+    size_t const n = simulation.size();
+    BodyStore<Real> const& bodies = simulation.bodies;
+    writeColumn(out, &header, sizeof(header));
+    for (auto const *column : {
+        &bodies.x,
+        &bodies.y,
+        &bodies.vx,
+        &bodies.vy,
+        &bodies.radii,
+        &bodies.masses,
+    }) {
+        writeColumn(out, column->data(), n * sizeof(Real));
+    }
+    std::vector<uint32_t> const materials(
+        simulation.materials.begin(),
+        simulation.materials.end()
+    );
+    writeColumn(out, materials.data(), n * sizeof(uint32_t));
+    writeColumn(out, simulation.colors.data(), n * sizeof(Rgba));
+    out.flush();
+    return out.good() ? Status::ok : Status::cannotWrite;
+}
+
+Snapshot::Status Snapshot::readInto(char const *path, Simulation& simulation) {
+    MappedFile const file(path);
+    if (!file.isOpen()) {
+        return Status::cannotOpen;
+    }
+    if (file.size() < sizeof(Header)) {
+        return Status::truncated;
+    }
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        return Status::notASnapshot;
+    }
+    if (header.byteOrderMark != byteOrderMark) {
+        return Status::wrongByteOrder;
+    }
+    if (
+        header.version != version
+    ||  (header.scalarSize != sizeof(float)
+        && header.scalarSize != sizeof(double))
+    ) {
+        return Status::unsupportedVersion;
+    }
+    // The offsets are recomputed rather than trusted, a file whose header
+    // disagrees with its own body count is corrupt.
+    Header expected = header;
+    if (
+        layOut(expected) > file.size()
+    ||  !std::equal(
+            std::begin(header.columnOffsets),
+            std::end(header.columnOffsets),
+            std::begin(expected.columnOffsets)
+        )
+    ) {
+        return Status::truncated;
+    }
+
+    size_t const n = header.bodyCount;
+    auto const columnAt = [&](Column column) {
+        return file.data() + header.columnOffsets[size_t(column)];
+    };
+    uint32_t const *materials =
+        reinterpret_cast<uint32_t const *>(columnAt(Column::materials));
+    size_t const materialCount = simulation.materialsTable.size();
+    if (std::any_of(
+        materials,
+        materials + n,
+        [&](uint32_t m) { return m >= materialCount; }
+    )) {
+        return Status::unknownMaterial;
+    }
+
+    simulation.resize(n);
+    BodyStore<Real>& bodies = simulation.bodies;
+    std::pair<Column, AlignedVector<Real> *> const scalarColumns[] = {
+        {Column::x, &bodies.x},
+        {Column::y, &bodies.y},
+        {Column::vx, &bodies.vx},
+        {Column::vy, &bodies.vy},
+        {Column::radii, &bodies.radii},
+        {Column::masses, &bodies.masses},
+    };
+    for (auto const& [column, to] : scalarColumns) {
+        if (header.scalarSize == sizeof(float)) {
+            readScalars<float>(columnAt(column), n, *to);
+        } else {
+            readScalars<double>(columnAt(column), n, *to);
+        }
+    }
+    std::copy(materials, materials + n, simulation.materials.begin());
+    std::memcpy(
+        simulation.colors.data(),
+        columnAt(Column::colors),
+        n * sizeof(Rgba)
+    );
+    simulation.time = header.time;
+    simulation.theta = header.theta;
+    simulation.gamma = header.gamma;
+    return Status::ok;
+}
+
+char const *Snapshot::describe(Status status) {
+    switch (status) {
+    case Status::ok:
+        return "ok";
+    case Status::cannotOpen:
+        return "could not open the file";
+    case Status::cannotWrite:
+        return "could not write the file";
+    case Status::truncated:
+        return "the file is shorter than its header says";
+    case Status::notASnapshot:
+        return "not a snapshot";
+    case Status::unsupportedVersion:
+        return "unsupported snapshot version";
+    case Status::wrongByteOrder:
+        return "written on a machine of the other byte order";
+    case Status::unknownMaterial:
+        return "a body's material isn't in the materials table";
+    }
+    return "unknown error";
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef PARSIM_SNAPSHOT_H
+#define PARSIM_SNAPSHOT_H
+
+#include <cstdint>
+
+#include "simulation.hpp"
+
+// A binary checkpoint of a simulation: a fixed header followed by one
+// column per body quantity, each starting on a 64 byte boundary of the file.
+// Loading maps the file and copies whole columns, there's nothing to parse
+// per body.
+//
+// Layout, in the byte order of the machine that wrote it:
+//   header (`Snapshot::Header`)
+//   x, y, vx, vy, radii, masses   `scalarSize` bytes per body each
+//   materials                     uint32 per body
+//   colors                        r, g, b, a bytes per body
+//
+// The materials are indices into the `materialsTable` of the simulation
+// loading the snapshot, which isn't stored.
+class Snapshot {
+public:
+    static constexpr char magic[8] = {'P', 'S', 'I', 'M', 'S', 'N', 'A', 'P'};
+    static constexpr uint32_t version = 1;
+    // reads back as something else on a machine of the other endianness
+    static constexpr uint32_t byteOrderMark = 0x01020304;
+    static constexpr size_t columnAlignment = 64;
+
+    enum class Column {
+        x,
+        y,
+        vx,
+        vy,
+        radii,
+        masses,
+        materials,
+        colors,
+        count,
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrderMark;
+        // 4 for float, 8 for double, see `Real`
+        uint32_t scalarSize;
+        uint32_t reserved;
+        uint64_t bodyCount;
+        double time;
+        float theta;
+        float gamma;
+        // from the start of the file
+        uint64_t columnOffsets[size_t(Column::count)];
+    };
+
+    enum class Status {
+        ok,
+        cannotOpen,
+        cannotWrite,
+        truncated,
+        notASnapshot,
+        unsupportedVersion,
+        wrongByteOrder,
+        // a material index past the end of the simulation's table
+        unknownMaterial,
+    };
+
+    static Status write(Simulation const& simulation, char const *path);
+    // Replaces the bodies of `simulation` with the snapshot's and sets its
+    // `time`, `theta` and `gamma`. Columns written in the other precision
+    // are converted.
+    static Status readInto(char const *path, Simulation& simulation);
+    static char const *describe(Status status);
+};
+
+#endif /* PARSIM_SNAPSHOT_H */
\ No newline at end of file
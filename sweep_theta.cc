@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "simulation.hpp"
+#include "barnes_hut.hpp"
+#include "direct_sum.hpp"
+#include "world.hpp"
+
+// Computes the forces with Barnes-Hut at a range of `theta` and prints the
+// percentiles of the relative force error against a direct sum next to the
+// wall time, then the fastest setting that meets an error budget. The time
+// is that of `Simulation::computeForces`, best of `--repeat`, so it includes
+// building the tree.
+
+namespace {
+struct Options {
+    char const *bodiesPath = "bodies.csv";
+    std::vector<float> thetas = {0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f,
+        1.f, 1.2f};
+    // with quadrupole moments as well as without
+    bool quadrupoles = false;
+    size_t groupSize = 0;
+    size_t leafCapacity = 8;
+    QuadTree::BuildMode buildMode = QuadTree::BuildMode::morton;
+    size_t threads = ThreadPool::defaultThreadCount();
+    size_t repeat = 3;
+    // p99 relative error, 0 doesn't pick
+    double budget = 0.;
+};
+
+struct Row {
+    float theta;
+    bool quadrupoles;
+    double seconds;
+    double interactionsPerBody;
+    // relative error percentiles
+    double median;
+    double p90;
+    double p99;
+    double max;
+};
+
+void usage(char const *argv0) {
+    std::cerr
+        <<"usage: "<<argv0<<" [options] [bodies.csv]"<<std::endl
+        <<"  --thetas A,B,...           values to try"
+        <<" (0.2,0.3,...,0.8,1,1.2)"<<std::endl
+        <<"  --quadrupoles              try each with quadrupoles too"
+        <<std::endl
+        <<"  --group-size N             Barnes-Hut group size (0)"
+        <<std::endl
+        <<"  --leaf-capacity N          bodies per quad tree leaf (8)"
+        <<std::endl
+        <<"  --build incremental|morton quad tree construction (morton)"
+        <<std::endl
+        <<"  --threads N                force phase threads (all cores)"
+        <<std::endl
+        <<"  --repeat N                 timed runs per setting (3)"
+        <<std::endl
+        <<"  --budget ERR               pick the fastest setting with a"
+        <<std::endl
+        <<"                             p99 relative error under ERR"
+        <<std::endl;
+}
+
+bool parseThetas(char const *list, std::vector<float>& thetas) {
+    thetas.clear();
+    char const *p = list;
+    while (*p) {
+        char *end;
+        float const theta = std::strtof(p, &end);
+        if (end == p || theta <= 0.f) {
+            return false;
+        }
+        thetas.push_back(theta);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return !thetas.empty();
+}
+
+bool parseOptions(int argc, char **argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string const arg = argv[i];
+        bool const hasValue = i + 1 < argc;
+        if (arg == "--thetas" && hasValue) {
+            if (!parseThetas(argv[++i], options.thetas)) {
+                return false;
+            }
+        } else if (arg == "--quadrupoles") {
+            options.quadrupoles = true;
+        } else if (arg == "--group-size" && hasValue) {
+            options.groupSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--leaf-capacity" && hasValue) {
+            options.leafCapacity = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--build" && hasValue) {
+            std::string const mode = argv[++i];
+            if (mode == "incremental") {
+                options.buildMode = QuadTree::BuildMode::incremental;
+            } else if (mode == "morton") {
+                options.buildMode = QuadTree::BuildMode::morton;
+            } else {
+                return false;
+            }
+        } else if (arg == "--threads" && hasValue) {
+            options.threads = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--repeat" && hasValue) {
+            options.repeat = std::max<size_t>(
+                std::strtoull(argv[++i], nullptr, 10),
+                1
+            );
+        } else if (arg == "--budget" && hasValue) {
+            options.budget = std::strtod(argv[++i], nullptr);
+        } else if (arg.size() > 0 && arg[0] != '-') {
+            options.bodiesPath = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// best of `repeat`
+double timeForces(Simulation& simulation, size_t repeat) {
+    double best = 0.;
+    for (size_t r = 0; r < repeat; r++) {
+        auto const start = std::chrono::steady_clock::now();
+        simulation.computeForces();
+        std::chrono::duration<double> const elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = r == 0 ? elapsed.count() : std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+// fills in the error percentiles of `row`
+void measureErrors(
+    std::vector<RealVec2> const& forces,
+    std::vector<RealVec2> const& reference,
+    Row& row
+) {
+    std::vector<double> errors;
+    for (size_t e = 0; e < forces.size(); e++) {
+        BasicVec2<double> const expected = vec2Cast<double>(reference[e]);
+        if (abs(expected) > 0.) {
+            errors.push_back(
+                abs(vec2Cast<double>(forces[e]) - expected) / abs(expected)
+            );
+        }
+    }
+    if (errors.empty()) {
+        row.median = row.p90 = row.p99 = row.max = 0.;
+        return;
+    }
+    std::sort(errors.begin(), errors.end());
+    size_t const n = errors.size();
+    row.median = errors[n / 2];
+    row.p90 = errors[n * 90 / 100];
+    row.p99 = errors[n * 99 / 100];
+    row.max = errors.back();
+}
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Simulation simulation =
+        World::create(World::defaultScreen, 0.5f, options.buildMode);
+    simulation.setThreadCount(options.threads);
+    simulation.tree.leafCapacity = options.leafCapacity;
+    // centered on the pointer like every other front end
+    if (!World::load({options.bodiesPath}, simulation)) {
+        return 1;
+    }
+    size_t const n = simulation.size();
+    if (n == 0) {
+        return 0;
+    }
+
+    simulation.setSolver(std::make_unique<DirectSumSolver>());
+    double const referenceSeconds = timeForces(simulation, 1);
+    std::vector<RealVec2> const reference = simulation.forces;
+    std::printf(
+        "bodies: %zu, threads: %zu, direct sum: %.1f ms\n",
+        n,
+        simulation.threadCount(),
+        referenceSeconds * 1e3
+    );
+
+    auto solver = std::make_unique<BarnesHutSolver>(options.groupSize);
+    BarnesHutSolver const& barnesHut = *solver;
+    simulation.setSolver(std::move(solver));
+    std::vector<Row> rows;
+    std::printf(
+        "%6s %5s %10s %14s %10s %10s %10s %10s\n",
+        "theta", "quad", "ms", "interact/body",
+        "median", "p90", "p99", "max"
+    );
+    for (bool quadrupoles : {false, true}) {
+        if (quadrupoles && !options.quadrupoles) {
+            continue;
+        }
+        for (float theta : options.thetas) {
+            simulation.theta = theta;
+            simulation.quadrupoles = quadrupoles;
+            Row row;
+            row.theta = theta;
+            row.quadrupoles = quadrupoles;
+            row.seconds = timeForces(simulation, options.repeat);
+            auto const interactions = barnesHut.interactions();
+            row.interactionsPerBody =
+                double(interactions.cells + interactions.bodies) / n;
+            measureErrors(simulation.forces, reference, row);
+            rows.push_back(row);
+            std::printf(
+                "%6.2f %5s %10.2f %14.1f %10.2e %10.2e %10.2e %10.2e\n",
+                row.theta,
+                row.quadrupoles ? "yes" : "no",
+                row.seconds * 1e3,
+                row.interactionsPerBody,
+                row.median,
+                row.p90,
+                row.p99,
+                row.max
+            );
+        }
+    }
+
+    if (options.budget <= 0.) {
+        return 0;
+    }
+    Row const *best = nullptr;
+    for (Row const& row : rows) {
+        if (
+            row.p99 <= options.budget
+        &&  (!best || row.seconds < best->seconds)
+        ) {
+            best = &row;
+        }
+    }
+    if (!best) {
+        std::printf("no setting has a p99 error under %g\n", options.budget);
+        return 1;
+    }
+    std::printf(
+        "fastest with a p99 error under %g: theta %.2f%s, %.2f ms\n",
+        options.budget,
+        best->theta,
+        best->quadrupoles ? " with quadrupoles" : "",
+        best->seconds * 1e3
+    );
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <algorithm>
+
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(size_t threads) {
+    start(threads);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+size_t ThreadPool::size() const {
+    return workers.size() + 1;
+}
+
+void ThreadPool::resize(size_t threads) {
+    if (threads == size()) {
+        return;
+    }
+    stop();
+    start(threads);
+}
+
+void ThreadPool::parallelFor(size_t n, size_t chunk, Task const& task) {
+    chunk = std::max<size_t>(chunk, 1);
+    if (workers.empty() || n <= chunk) {
+        if (n > 0) {
+            task(0, n);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = &task;
+        count = n;
+        chunkSize = chunk;
+        next = 0;
+        pending = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    drain();
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+    current = nullptr;
+}
+
+size_t ThreadPool::defaultThreadCount() {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void ThreadPool::start(size_t threads) {
+    stopping = false;
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, generation);
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::workerLoop(size_t seen) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        drain();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+}
+
+void ThreadPool::drain() {
+    for (;;) {
+        size_t const begin = next.fetch_add(chunkSize);
+        if (begin >= count) {
+            break;
+        }
+        (*current)(begin, std::min(begin + chunkSize, count));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef PARSIM_THREAD_POOL_H
+#define PARSIM_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A persistent pool of worker threads. Work is handed out in fixed-size
+// chunks from a shared atomic counter, so threads that finish early keep
+// pulling chunks until the range is exhausted. The calling thread takes part
+// in the work too, so a pool of size 1 has no workers and runs inline.
+class ThreadPool {
+public:
+    //                        [ begin, end )
+    using Task = std::function<void(size_t, size_t)>;
+
+    explicit ThreadPool(size_t threads = defaultThreadCount());
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+    ~ThreadPool();
+
+    // threads taking part in the work, including the caller
+    size_t size() const;
+    void resize(size_t threads);
+    // runs `task` over [0, n) in chunks of at most `chunk` and returns when
+    // every chunk is done
+    void parallelFor(size_t n, size_t chunk, Task const& task);
+
+    static size_t defaultThreadCount();
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping = false;
+    size_t generation = 0;
+    size_t pending = 0;
+
+    Task const *current = nullptr;
+    size_t count = 0;
+    size_t chunkSize = 1;
+    std::atomic<size_t> next{0};
+
+    void start(size_t threads);
+    void stop();
+    void workerLoop(size_t seen);
+    void drain();
+};
+
+#endif /* PARSIM_THREAD_POOL_H */
\ No newline at end of file
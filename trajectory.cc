@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "trajectory.hpp"
+#include "simulation.hpp"
+
+namespace {
+size_t constexpr maxRun = 128;
+
+// Zero runs of 2 to 128 bytes become the byte 128 + length - 1, everything
+// else goes in literal runs of up to 128 bytes behind the byte length - 1.
+void packRuns(
+    unsigned char const *data,
+    size_t n,
+    std::vector<unsigned char>& out
+) {
+    for (size_t i = 0; i < n;) {
+        size_t zeros = 0;
+        while (i + zeros < n && zeros < maxRun && data[i + zeros] == 0) {
+            zeros++;
+        }
+        if (zeros >= 2) {
+            out.push_back(maxRun + zeros - 1);
+            i += zeros;
+            continue;
+        }
+        size_t length = 1;
+        while (
+            i + length < n
+        &&  length < maxRun
+        &&  !(
+                data[i + length] == 0
+            &&  i + length + 1 < n
+            &&  data[i + length + 1] == 0
+            )
+        ) {
+            length++;
+        }
+        out.push_back(length - 1);
+        out.insert(out.end(), data + i, data + i + length);
+        i += length;
+    }
+}
+
+bool unpackRuns(
+    unsigned char const *in,
+    size_t size,
+    unsigned char *data,
+    size_t n
+) {
+    unsigned char const *end = in + size;
+    size_t i = 0;
+    while (in < end) {
+        size_t const control = *in++;
+        if (control >= maxRun) {
+            size_t const zeros = control - maxRun + 1;
+            if (i + zeros > n) {
+                return false;
+            }
+            std::memset(data + i, 0, zeros);
+            i += zeros;
+        } else {
+            size_t const length = control + 1;
+            if (i + length > n || length > size_t(end - in)) {
+                return false;
+            }
+            std::memcpy(data + i, in, length);
+            in += length;
+            i += length;
+        }
+    }
+    return i == n;
+}
+
+// `previous` is empty for a column coded as is
+void encodeColumn(
+    unsigned char const *bytes,
+    std::vector<unsigned char> const& previous,
+    size_t n,
+    size_t scalarSize,
+    std::vector<unsigned char>& planes,
+    std::vector<unsigned char>& out
+) {
+    planes.resize(n * scalarSize);
+    bool const delta = previous.size() == planes.size();
+    for (size_t b = 0; b < scalarSize; b++) {
+        unsigned char *plane = planes.data() + b * n;
+        for (size_t i = 0; i < n; i++) {
+            size_t const at = i * scalarSize + b;
+            plane[i] = delta ? bytes[at] ^ previous[at] : bytes[at];
+        }
+    }
+    packRuns(planes.data(), planes.size(), out);
+}
+
+bool decodeColumn(
+    unsigned char const *in,
+    size_t size,
+    std::vector<unsigned char> const& previous,
+    size_t n,
+    size_t scalarSize,
+    std::vector<unsigned char>& planes,
+    unsigned char *bytes
+) {
+    planes.resize(n * scalarSize);
+    if (!unpackRuns(in, size, planes.data(), planes.size())) {
+        return false;
+    }
+    bool const delta = previous.size() == planes.size();
+    for (size_t b = 0; b < scalarSize; b++) {
+        unsigned char const *plane = planes.data() + b * n;
+        for (size_t i = 0; i < n; i++) {
+            size_t const at = i * scalarSize + b;
+            bytes[at] = delta ? plane[i] ^ previous[at] : plane[i];
+        }
+    }
+    return true;
+}
+
+template <typename Stored>
+void convertColumn(
+    std::vector<unsigned char> const& bytes,
+    AlignedVector<Real>& to
+) {
+    size_t const n = bytes.size() / sizeof(Stored);
+    to.resize(n);
+    if constexpr (std::is_same_v<Stored, Real>) {
+        std::memcpy(to.data(), bytes.data(), bytes.size());
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            Stored value;
+            std::memcpy(
+                &value,
+                bytes.data() + i * sizeof(Stored),
+                sizeof(value)
+            );
+            to[i] = Real(value);
+        }
+    }
+}
+
+template <typename T>
+void writeValue(std::ofstream& out, T value) {
+    out.write(reinterpret_cast<char const *>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value) {
+    return bool(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+}
+
+size_t TrajectoryFrame::size() const {
+    return x.size();
+}
+
+TrajectoryRecorder::TrajectoryRecorder(
+    char const *path,
+    size_t _every,
+    size_t bufferCount,
+    WhenFull _whenFull
+)
+: out(path, std::ios::binary | std::ios::trunc)
+, every(std::max<size_t>(_every, 1))
+, whenFull(_whenFull)
+, ring(std::max<size_t>(bufferCount, 1)) {
+    if (!out.is_open()) {
+        return;
+    }
+    out.write(trajectory::magic, sizeof(trajectory::magic));
+    writeValue(out, trajectory::version);
+    writeValue(out, uint32_t(sizeof(Real)));
+    writer = std::thread(&TrajectoryRecorder::writerLoop, this);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    filledOne.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+bool TrajectoryRecorder::isOpen() const {
+    return out.is_open();
+}
+
+void TrajectoryRecorder::record(Simulation const& simulation) {
+    uint64_t const index = calls++;
+    if (index % every != 0 || !isOpen()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (filled == ring.size()) {
+        if (whenFull == WhenFull::drop) {
+            counters.dropped++;
+            return;
+        }
+        counters.waits++;
+        freedOne.wait(lock, [this] { return filled < ring.size(); });
+    }
+    // The writer only touches filled buffers, so this one is ours until it's
+    // counted in.
+    TrajectoryFrame& frame = ring[head];
+    lock.unlock();
+
+    BodyStore<Real> const& bodies = simulation.bodies;
+    frame.index = index;
+    frame.time = simulation.time;
+    frame.x.assign(bodies.x.begin(), bodies.x.end());
+    frame.y.assign(bodies.y.begin(), bodies.y.end());
+    frame.vx.assign(bodies.vx.begin(), bodies.vx.end());
+    frame.vy.assign(bodies.vy.begin(), bodies.vy.end());
+
+    lock.lock();
+    head = (head + 1) % ring.size();
+    filled++;
+    counters.recorded++;
+    lock.unlock();
+    filledOne.notify_one();
+}
+
+void TrajectoryRecorder::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    freedOne.wait(lock, [this] { return filled == 0; });
+}
+
+TrajectoryRecorder::Stats TrajectoryRecorder::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void TrajectoryRecorder::writerLoop() {
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex);
+        filledOne.wait(lock, [this] { return filled > 0 || stopping; });
+        if (filled == 0) {
+            return;
+        }
+        TrajectoryFrame const& frame = ring[tail];
+        lock.unlock();
+
+        writeFrame(frame);
+
+        lock.lock();
+        tail = (tail + 1) % ring.size();
+        filled--;
+        lock.unlock();
+        // `record` and `flush` may both be waiting
+        freedOne.notify_all();
+    }
+}
+
+void TrajectoryRecorder::writeFrame(TrajectoryFrame const& frame) {
+    size_t const n = frame.size();
+    writeValue(out, frame.index);
+    writeValue(out, frame.time);
+    writeValue(out, uint64_t(n));
+    uint64_t written = 3 * sizeof(uint64_t);
+    AlignedVector<Real> const *columns[] = {
+        &frame.x,
+        &frame.y,
+        &frame.vx,
+        &frame.vy,
+    };
+    for (size_t c = 0; c < 4; c++) {
+        unsigned char const *bytes =
+            reinterpret_cast<unsigned char const *>(columns[c]->data());
+        encoded.clear();
+        encodeColumn(bytes, previous[c], n, sizeof(Real), planes, encoded);
+        writeValue(out, uint64_t(encoded.size()));
+        out.write(
+            reinterpret_cast<char const *>(encoded.data()),
+            encoded.size()
+        );
+        written += sizeof(uint64_t) + encoded.size();
+        previous[c].assign(bytes, bytes + n * sizeof(Real));
+    }
+    out.flush();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.framesWritten++;
+    counters.rawBytes += 3 * sizeof(uint64_t) + 4 * n * sizeof(Real);
+    counters.bytesWritten += written;
+    counters.writeFailed = counters.writeFailed || !out.good();
+}
+
+TrajectoryReader::TrajectoryReader(char const *path)
+: in(path, std::ios::binary) {
+    char magic[sizeof(trajectory::magic)];
+    uint32_t version;
+    valid =
+        in.read(magic, sizeof(magic))
+    &&  std::memcmp(magic, trajectory::magic, sizeof(magic)) == 0
+    &&  readValue(in, version)
+    &&  version == trajectory::version
+    &&  readValue(in, scalarSize)
+    &&  (scalarSize == sizeof(float) || scalarSize == sizeof(double));
+}
+
+bool TrajectoryReader::isOpen() const {
+    return valid;
+}
+
+bool TrajectoryReader::next(TrajectoryFrame& frame) {
+    uint64_t n;
+    if (
+        !valid
+    ||  !readValue(in, frame.index)
+    ||  !readValue(in, frame.time)
+    ||  !readValue(in, n)
+    ) {
+        return false;
+    }
+    AlignedVector<Real> *columns[] = {
+        &frame.x,
+        &frame.y,
+        &frame.vx,
+        &frame.vy,
+    };
+    std::vector<unsigned char> bytes(n * scalarSize);
+    for (size_t c = 0; c < 4; c++) {
+        uint64_t size;
+        if (!readValue(in, size)) {
+            return valid = false;
+        }
+        encoded.resize(size);
+        if (
+            !in.read(reinterpret_cast<char *>(encoded.data()), size)
+        ||  !decodeColumn(
+                encoded.data(),
+                size,
+                previous[c],
+                n,
+                scalarSize,
+                planes,
+                bytes.data()
+            )
+        ) {
+            return valid = false;
+        }
+        previous[c] = bytes;
+        if (scalarSize == sizeof(float)) {
+            convertColumn<float>(bytes, *columns[c]);
+        } else {
+            convertColumn<double>(bytes, *columns[c]);
+        }
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#ifndef PARSIM_TRAJECTORY_H
+#define PARSIM_TRAJECTORY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "body_store.hpp"
+
+class Simulation;
+
+// Recorded positions and velocities of every body at one moment.
+struct TrajectoryFrame {
+    // `record` calls before this one, dropped frames leave gaps
+    uint64_t index = 0;
+    double time = 0.;
+    AlignedVector<Real> x;
+    AlignedVector<Real> y;
+    AlignedVector<Real> vx;
+    AlignedVector<Real> vy;
+
+    size_t size() const;
+};
+
+// Trajectory files start with "PSIMTRAJ", a version and the scalar size,
+// followed by frames of
+//   index, time, body count, columns encoded against the previous frame
+// Each of x, y, vx and vy is stored as the bit patterns of its scalars xor
+// those of the previous frame, or as is when the body count changed. The
+// xor is split into byte planes, all the lowest bytes first, so the bytes
+// of the sign and exponent that rarely change from frame to frame end up in
+// long runs of zeros, and the planes are run-length coded.
+namespace trajectory {
+inline constexpr char magic[8] = {'P', 'S', 'I', 'M', 'T', 'R', 'A', 'J'};
+inline constexpr uint32_t version = 1;
+}
+
+// Records the bodies every `every` calls to `record` without waiting on the
+// disk. `record` copies the columns into the next free buffer of a ring and
+// returns. A background thread encodes the buffers in order and writes them
+// out. When every buffer is still waiting to be written, `record` either
+// waits for one or drops the frame, counting either.
+class TrajectoryRecorder {
+public:
+    enum class WhenFull {
+        wait,
+        drop,
+    };
+
+    struct Stats {
+        // frames handed to the writer
+        uint64_t recorded = 0;
+        // frames skipped because the ring was full with `WhenFull::drop`
+        uint64_t dropped = 0;
+        // calls that waited on a full ring with `WhenFull::wait`
+        uint64_t waits = 0;
+        uint64_t framesWritten = 0;
+        // what the frames would've taken uncompressed, and what they took
+        uint64_t rawBytes = 0;
+        uint64_t bytesWritten = 0;
+        bool writeFailed = false;
+    };
+
+    TrajectoryRecorder(
+        char const *path,
+        size_t every = 1,
+        size_t bufferCount = 4,
+        WhenFull whenFull = WhenFull::wait
+    );
+    TrajectoryRecorder(TrajectoryRecorder const&) = delete;
+    TrajectoryRecorder& operator=(TrajectoryRecorder const&) = delete;
+    // writes what's left in the ring
+    ~TrajectoryRecorder();
+
+    bool isOpen() const;
+    // call once per update
+    void record(Simulation const& simulation);
+    // waits until every recorded frame is on disk
+    void flush();
+    Stats stats() const;
+
+private:
+    std::ofstream out;
+    size_t every;
+    WhenFull whenFull;
+    uint64_t calls = 0;
+
+    std::vector<TrajectoryFrame> ring;
+    // guards everything below
+    mutable std::mutex mutex;
+    std::condition_variable filledOne;
+    std::condition_variable freedOne;
+    // the next buffer to fill and to write
+    size_t head = 0;
+    size_t tail = 0;
+    size_t filled = 0;
+    bool stopping = false;
+    Stats counters;
+
+    // the writer's own, only touched by its thread
+    std::vector<unsigned char> previous[4];
+    std::vector<unsigned char> encoded;
+    std::vector<unsigned char> planes;
+
+    std::thread writer;
+
+    void writerLoop();
+    void writeFrame(TrajectoryFrame const& frame);
+};
+
+// Reads back what a `TrajectoryRecorder` wrote, converting to `Real` if it
+// was written in the other precision.
+class TrajectoryReader {
+public:
+    explicit TrajectoryReader(char const *path);
+    // false when the file couldn't be opened or isn't a trajectory
+    bool isOpen() const;
+    // false at the end of the file or on a damaged frame
+    bool next(TrajectoryFrame& frame);
+
+private:
+    std::ifstream in;
+    bool valid = false;
+    uint32_t scalarSize = 0;
+    // x, y, vx and vy of the last frame as stored
+    std::vector<unsigned char> previous[4];
+    std::vector<unsigned char> encoded;
+    std::vector<unsigned char> planes;
+};
+
+#endif /* PARSIM_TRAJECTORY_H */
\ No newline at end of file
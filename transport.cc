@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "transport.hpp"
+
+namespace {
+// A message goes out as its length and then its bytes.
+struct Channel {
+    int fd;
+    Transport::Message const *out;
+    Transport::Message *in;
+    uint64_t outLength;
+    uint64_t inLength = 0;
+    // bytes of length and message so far
+    size_t written = 0;
+    size_t read = 0;
+
+    bool sending() const {
+        return written < sizeof(outLength) + out->size();
+    }
+    bool receiving() const {
+        return read < sizeof(inLength) || read < sizeof(inLength) + inLength;
+    }
+};
+
+// false on a closed or broken socket, true when it would block
+bool writeSome(Channel& c) {
+    char const *from;
+    size_t left;
+    if (c.written < sizeof(c.outLength)) {
+        from = reinterpret_cast<char const *>(&c.outLength) + c.written;
+        left = sizeof(c.outLength) - c.written;
+    } else {
+        size_t const at = c.written - sizeof(c.outLength);
+        from = c.out->data() + at;
+        left = c.out->size() - at;
+    }
+    ssize_t const n = send(c.fd, from, left, MSG_NOSIGNAL);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    c.written += n;
+    return true;
+}
+
+bool readSome(Channel& c) {
+    char *to;
+    size_t left;
+    if (c.read < sizeof(c.inLength)) {
+        to = reinterpret_cast<char *>(&c.inLength) + c.read;
+        left = sizeof(c.inLength) - c.read;
+    } else {
+        size_t const at = c.read - sizeof(c.inLength);
+        to = c.in->data() + at;
+        left = c.inLength - at;
+    }
+    ssize_t const n = recv(c.fd, to, left, 0);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (n == 0) {
+        return false;
+    }
+    c.read += n;
+    if (c.read == sizeof(c.inLength)) {
+        c.in->resize(c.inLength);
+    }
+    return true;
+}
+}
+
+Transport::Transport(size_t _self, std::vector<int> _peers)
+: self(_self)
+, peers(std::move(_peers)) {
+    for (int fd : peers) {
+        if (fd >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+}
+
+Transport::~Transport() {
+    for (int fd : peers) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+int Transport::spawn(
+    size_t ranks,
+    std::function<int(Transport&)> const& body
+) {
+    ranks = std::max<size_t>(ranks, 1);
+    //                       [ rank ][ peer ]
+    std::vector<std::vector<int>> sockets(ranks, std::vector<int>(ranks, -1));
+    // closes the rows of every rank but `kept`, all of them when it's
+    // `ranks`
+    auto const closeAllBut = [&](size_t kept) {
+        for (size_t r = 0; r < ranks; r++) {
+            if (r == kept) {
+                continue;
+            }
+            for (int fd : sockets[r]) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        }
+    };
+    for (size_t a = 0; a < ranks; a++) {
+        for (size_t b = a + 1; b < ranks; b++) {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                std::perror("socketpair");
+                closeAllBut(ranks);
+                return 1;
+            }
+            sockets[a][b] = pair[0];
+            sockets[b][a] = pair[1];
+        }
+    }
+    std::vector<pid_t> children;
+    for (size_t rank = 1; rank < ranks; rank++) {
+        // what's buffered would be written by the child as well
+        std::fflush(nullptr);
+        pid_t const pid = fork();
+        if (pid < 0) {
+            std::perror("fork");
+            break;
+        }
+        if (pid == 0) {
+            int status;
+            // each rank keeps its own row
+            closeAllBut(rank);
+            {
+                Transport transport(rank, sockets[rank]);
+                status = body(transport);
+            }
+            std::fflush(nullptr);
+            _exit(status);
+        }
+        children.push_back(pid);
+    }
+    int result = 1;
+    if (children.size() == ranks - 1) {
+        closeAllBut(0);
+        Transport transport(0, sockets[0]);
+        result = body(transport);
+    } else {
+        // the children that did start see their peers go away
+        closeAllBut(ranks);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            result = result ? result : 1;
+        }
+    }
+    return result;
+}
+
+size_t Transport::rank() const {
+    return self;
+}
+
+size_t Transport::size() const {
+    return peers.size();
+}
+
+bool Transport::exchange(
+    std::vector<Message> const& outgoing,
+    std::vector<Message>& incoming
+) {
+    incoming.resize(size());
+    incoming[self] = outgoing[self];
+    std::vector<Channel> channels;
+    for (size_t r = 0; r < size(); r++) {
+        if (r == self) {
+            continue;
+        }
+        incoming[r].clear();
+        Channel c;
+        c.fd = peers[r];
+        c.out = &outgoing[r];
+        c.in = &incoming[r];
+        c.outLength = outgoing[r].size();
+        channels.push_back(c);
+        sent += outgoing[r].size();
+    }
+    std::vector<pollfd> polled(channels.size());
+    for (;;) {
+        size_t busy = 0;
+        for (size_t i = 0; i < channels.size(); i++) {
+            short events = 0;
+            if (channels[i].sending()) {
+                events |= POLLOUT;
+            }
+            if (channels[i].receiving()) {
+                events |= POLLIN;
+            }
+            // poll skips negative descriptors, a peer that's done with
+            // this exchange may already have hung up
+            polled[i] = {events ? channels[i].fd : -1, events, 0};
+            busy += events != 0;
+        }
+        if (busy == 0) {
+            return true;
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        for (size_t i = 0; i < channels.size(); i++) {
+            short const ready = polled[i].revents;
+            if (ready & (POLLERR | POLLNVAL)) {
+                return false;
+            }
+            if ((ready & POLLOUT) && !writeSome(channels[i])) {
+                return false;
+            }
+            if (!(ready & (POLLIN | POLLHUP))) {
+                continue;
+            }
+            // a hang up with data left still reads it, then fails on 0,
+            // one with only sending left can't go anywhere
+            if (!channels[i].receiving() || !readSome(channels[i])) {
+                return false;
+            }
+        }
+    }
+}
+
+bool Transport::allGather(Message const& mine, std::vector<Message>& all) {
+    std::vector<Message> const outgoing(size(), mine);
+    return exchange(outgoing, all);
+}
+
+uint64_t Transport::bytesSent() const {
+    return sent;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef PARSIM_TRANSPORT_H
+#define PARSIM_TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Ranks of a distributed run as processes on one machine, with a Unix
+// socket between every pair. Every call is collective: each rank has to
+// make it, in the same order.
+class Transport {
+public:
+    using Message = std::vector<char>;
+
+    // Forks `ranks - 1` children wired to the caller and to each other and
+    // runs `body` in each of them and in the caller, which is rank 0. A
+    // child exits with what `body` returns. Returns rank 0's result, or 1
+    // when a child failed. Must be called before starting any thread, the
+    // children only get the calling one.
+    static int spawn(
+        size_t ranks,
+        std::function<int(Transport&)> const& body
+    );
+
+    Transport(Transport const&) = delete;
+    Transport& operator=(Transport const&) = delete;
+    ~Transport();
+
+    size_t rank() const;
+    size_t size() const;
+    // Sends `outgoing[r]` to every rank r and fills `incoming[r]` with what
+    // rank r sent to this one, `incoming[rank()]` is `outgoing[rank()]`.
+    // Everything goes out and comes in at the same time, so no rank waits
+    // on another to read first. False when a peer went away.
+    bool exchange(
+        std::vector<Message> const& outgoing,
+        std::vector<Message>& incoming
+    );
+    // every rank gets every rank's `mine`, in rank order
+    bool allGather(Message const& mine, std::vector<Message>& all);
+    // payload bytes this rank sent since it started
+    uint64_t bytesSent() const;
+
+private:
+    size_t self;
+    // a connected socket per rank, -1 for this one
+    std::vector<int> peers;
+    uint64_t sent = 0;
+
+    Transport(size_t _self, std::vector<int> _peers);
+};
+
+#endif /* PARSIM_TRANSPORT_H */
\ No newline at end of file
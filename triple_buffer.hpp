@@ -0,0 +1,53 @@
+#ifndef PARSIM_TRIPLE_BUFFER_H
+#define PARSIM_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Hands values from one writer thread to one reader thread without either
+// waiting on the other. The writer fills `back` and publishes it, the reader
+// picks up the newest published value with `update` and reads `front`.
+// Three slots so each side always has one of its own while the third sits
+// in the middle, values the reader never got to are overwritten.
+template <typename T>
+class TripleBuffer {
+public:
+    // the writer's slot
+    T& back() {
+        return slots[backIndex];
+    }
+    // Swaps the back slot into the middle, the writer carries on in the one
+    // that was there.
+    void publish() {
+        backIndex =
+            middle.exchange(backIndex | fresh, std::memory_order_acq_rel)
+            & indexMask;
+    }
+    // Takes the middle slot if something was published since the last
+    // call, returns whether `front` changed.
+    bool update() {
+        if ((middle.load(std::memory_order_acquire) & fresh) == 0) {
+            return false;
+        }
+        frontIndex =
+            middle.exchange(frontIndex, std::memory_order_acq_rel)
+            & indexMask;
+        return true;
+    }
+    // the reader's slot
+    T const& front() const {
+        return slots[frontIndex];
+    }
+
+private:
+    static constexpr uint8_t indexMask = 3;
+    // set in `middle` while the reader hasn't taken it
+    static constexpr uint8_t fresh = 4;
+
+    T slots[3];
+    uint8_t backIndex = 0;
+    std::atomic<uint8_t> middle{1};
+    uint8_t frontIndex = 2;
+};
+
+#endif /* PARSIM_TRIPLE_BUFFER_H */
\ No newline at end of file
@@ -1,34 +1,74 @@
 #ifndef PARSIM_UTIL_H
 #define PARSIM_UTIL_H
 #include <iostream>
-#include <raymath.h>
+#include <type_traits>
 
-static inline Vector2 operator+(Vector2 a, Vector2 b) {
-    return Vector2Add(a, b);
+#include "common.hpp"
+
+// Keeps the scalar operand out of template argument deduction, so that
+// `v * 2` or a float times a `BasicVec2<double>` convert it instead of
+// failing to match.
+template <typename T>
+using Undeduced = typename std::enable_if<true, T>::type;
+
+template <typename Scalar>
+static inline BasicVec2<Scalar> operator+(
+    BasicVec2<Scalar> a,
+    BasicVec2<Scalar> b
+) {
+    return {a.x + b.x, a.y + b.y};
 }
 
-static inline Vector2 operator-(Vector2 a, Vector2 b) {
-    return Vector2Subtract(a, b);
+template <typename Scalar>
+static inline BasicVec2<Scalar> operator-(
+    BasicVec2<Scalar> a,
+    BasicVec2<Scalar> b
+) {
+    return {a.x - b.x, a.y - b.y};
 }
 
-static inline Vector2 operator+=(Vector2 &a, Vector2 b) {
+template <typename Scalar>
+static inline BasicVec2<Scalar> operator+=(
+    BasicVec2<Scalar> &a,
+    BasicVec2<Scalar> b
+) {
     a = a + b;
     return a;
 }
 
-static inline Vector2 operator*(Vector2 a, float b) {
-    return Vector2Scale(a, b);
+template <typename Scalar>
+static inline BasicVec2<Scalar> operator*(
+    BasicVec2<Scalar> a,
+    Undeduced<Scalar> b
+) {
+    return {a.x * b, a.y * b};
+}
+
+template <typename Scalar>
+static inline BasicVec2<Scalar> operator/(
+    BasicVec2<Scalar> a,
+    Undeduced<Scalar> b
+) {
+    return a * (Scalar(1) / b);
 }
 
-static inline Vector2 operator/(Vector2 a, float b) {
-    return a * (1.f / b);
+template <typename Scalar>
+static inline Scalar abs(BasicVec2<Scalar> a) {
+    return std::sqrt(a.x * a.x + a.y * a.y);
 }
 
-static inline float abs(Vector2 a) {
-    return Vector2Length(a);
+// between precisions, e.g. from the `RealVec2` of the simulation to the
+// `Vec2` of the renderer
+template <typename To, typename From>
+static inline BasicVec2<To> vec2Cast(BasicVec2<From> a) {
+    return {To(a.x), To(a.y)};
 }
 
-static inline std::ostream& operator<<(std::ostream& o, Vector2 vec) {
+template <typename Scalar>
+static inline std::ostream& operator<<(
+    std::ostream& o,
+    BasicVec2<Scalar> vec
+) {
     return o<<"{x: "<<vec.x<<", y: "<<vec.y<<"}";
 }
 
@@ -0,0 +1,76 @@
+#include <iostream>
+
+#include "world.hpp"
+#include "body_csv_reader.hpp"
+#include "snapshot.hpp"
+
+std::vector<MaterialInfo> World::materials() {
+    return {
+        MaterialInfo {"A", 2.e8f},
+        MaterialInfo {"B", 1.5e3f},
+    };
+}
+
+Rect World::viewport(Vec2 screen) {
+    Rect viewport;
+    viewport.x = -screen.x * 3.f;
+    viewport.y = -screen.y * 3.f;
+    viewport.width = screen.x * 6.f;
+    viewport.height = screen.y * 6.f;
+    return viewport;
+}
+
+Simulation World::create(
+    Vec2 screen,
+    float theta,
+    QuadTree::BuildMode buildMode
+) {
+    return Simulation(
+        materials(),
+        viewport(screen),
+        theta,
+        screen / 2.f,
+        buildMode
+    );
+}
+
+bool World::load(Source const& source, Simulation& simulation) {
+    if (source.snapshotPath) {
+        Snapshot::Status const status =
+            Snapshot::readInto(source.snapshotPath, simulation);
+        if (status != Snapshot::Status::ok) {
+            std::cerr
+                <<source.snapshotPath<<": "<<Snapshot::describe(status)
+                <<std::endl;
+            return false;
+        }
+        return true;
+    }
+    if (source.generate) {
+        Generator generator = source.generator;
+        if (source.centered) {
+            generator.center = vec2Cast<Real>(simulation.pointer);
+        }
+        generator.addTo(simulation);
+        return true;
+    }
+    size_t const first = simulation.size();
+    BodyCSVReader reader(source.bodiesPath);
+    BodyCSVReader::Status const status = reader.readInto(simulation);
+    if (status != BodyCSVReader::Status::ok) {
+        std::cerr<<source.bodiesPath;
+        if (reader.errorLine() > 0) {
+            std::cerr<<":"<<reader.errorLine();
+        }
+        std::cerr<<": "<<BodyCSVReader::describe(status)<<std::endl;
+        return false;
+    }
+    if (!source.centered) {
+        return true;
+    }
+    for (Entity e = first; (size_t)e < simulation.size(); e++) {
+        simulation.bodies.x[e] += simulation.pointer.x;
+        simulation.bodies.y[e] += simulation.pointer.y;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef PARSIM_WORLD_H
+#define PARSIM_WORLD_H
+
+#include <vector>
+
+#include "simulation.hpp"
+#include "generators.hpp"
+
+// The world every front end starts from, so the same csv or snapshot
+// behaves the same in the window and in every tool: a viewport six screens
+// wide and high around the screen, the pointer at the screen's center and
+// the two materials the csv files refer to by index.
+class World {
+public:
+    // the window the windowed build opens, for the tools that have none
+    static constexpr Vec2 defaultScreen = {900.f, 700.f};
+
+    // Where the bodies come from, the snapshot when set, else the
+    // generator when set, else the csv.
+    struct Source {
+        char const *bodiesPath = "bodies.csv";
+        char const *snapshotPath = nullptr;
+        bool generate = false;
+        Generator generator;
+        // csv and generated bodies are moved so their origin is at the
+        // pointer, false keeps the coordinates they come with
+        bool centered = true;
+    };
+
+    static std::vector<MaterialInfo> materials();
+    static Rect viewport(Vec2 screen);
+    static Simulation create(
+        Vec2 screen = defaultScreen,
+        float theta = 0.5f,
+        QuadTree::BuildMode buildMode = QuadTree::BuildMode::incremental
+    );
+    // Appends the bodies of `source`. A snapshot is already in world
+    // coordinates, csv and generated bodies are centered on the pointer
+    // unless `source.centered` is false.
+    // On failure nothing is added and what went wrong is printed to
+    // stderr, as `path[:line]: message`.
+    static bool load(Source const& source, Simulation& simulation);
+};
+
+#endif /* PARSIM_WORLD_H */
\ No newline at end of file